@@ -0,0 +1,108 @@
+#pragma once
+
+#include "ImageIO.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+#include <limits>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace iipt {
+namespace bench {
+
+    // Smooth gradient with added noise, so filters see realistic (non-constant) content.
+    inline Image makeSyntheticImage(int width, int height, int channels, unsigned seed = 42) {
+        Image img;
+        img.width = width;
+        img.height = height;
+        img.channels = channels;
+        img.data.resize(static_cast<size_t>(width) * height * channels);
+
+        std::mt19937 rng(seed);
+        std::uniform_int_distribution<int> noise(-20, 20);
+        for (int y = 0; y < height; ++y) {
+            for (int x = 0; x < width; ++x) {
+                for (int c = 0; c < channels; ++c) {
+                    int base = (x * 255 / std::max(1, width - 1) + y * 255 / std::max(1, height - 1) + c * 60) / 2;
+                    img.data[(static_cast<size_t>(y) * width + x) * channels + c] =
+                        static_cast<unsigned char>(std::clamp(base + noise(rng), 0, 255));
+                }
+            }
+        }
+        return img;
+    }
+
+    // One untimed warmup run, then the fastest of `repetitions` timed runs in milliseconds.
+    template <typename Fn>
+    double measureMs(Fn&& fn, int repetitions = 3) {
+        fn();
+        double best = std::numeric_limits<double>::max();
+        for (int r = 0; r < repetitions; ++r) {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            auto end = std::chrono::steady_clock::now();
+            best = std::min(best, std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        return best;
+    }
+
+    struct TimingStats {
+        double minMs = 0.0;
+        double medianMs = 0.0;
+        double meanMs = 0.0;
+        double stddevMs = 0.0;
+        int repetitions = 0;
+    };
+
+    // `warmups` untimed runs, then `repetitions` timed runs. setup() runs before every
+    // call and is not timed (e.g. to restore the input of an in-place operation).
+    template <typename Setup, typename Fn>
+    TimingStats measureStats(Setup&& setup, Fn&& fn, int repetitions = 5, int warmups = 1) {
+        for (int w = 0; w < warmups; ++w) {
+            setup();
+            fn();
+        }
+        std::vector<double> samples;
+        for (int r = 0; r < std::max(1, repetitions); ++r) {
+            setup();
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            auto end = std::chrono::steady_clock::now();
+            samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+        }
+
+        TimingStats stats;
+        stats.repetitions = static_cast<int>(samples.size());
+        std::sort(samples.begin(), samples.end());
+        size_t n = samples.size();
+        stats.minMs = samples.front();
+        stats.medianMs = (n % 2) ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2.0;
+        for (double s : samples) stats.meanMs += s / n;
+        for (double s : samples) stats.stddevMs += (s - stats.meanMs) * (s - stats.meanMs) / n;
+        stats.stddevMs = std::sqrt(stats.stddevMs);
+        return stats;
+    }
+
+    inline double megapixelsPerSecond(int width, int height, double ms) {
+        return (static_cast<double>(width) * height / 1.0e6) / (ms / 1000.0);
+    }
+
+    // Optional "WIDTHxHEIGHT" command line argument, e.g. 3840x2160.
+    inline void parseSize(int argc, char** argv, int index, int& width, int& height) {
+        if (argc > index) {
+            std::string arg = argv[index];
+            size_t sep = arg.find('x');
+            if (sep != std::string::npos) {
+                width = std::atoi(arg.substr(0, sep).c_str());
+                height = std::atoi(arg.substr(sep + 1).c_str());
+            }
+        }
+    }
+
+} // namespace bench
+} // namespace iipt
@@ -0,0 +1,61 @@
+// Throughput of the generic 2-D convolution and the median filter for each padding
+// mode. On a large image the interior dominates, so this tracks the interior loop.
+//
+// Usage: borderSplitBenchmark [WIDTHxHEIGHT] [channels]   (default 3840x2160, 1 channel)
+
+#include "BenchUtils.h"
+#include "ImageSpatialTransformation.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace iipt;
+
+int main(int argc, char** argv) {
+    int width = 3840, height = 2160;
+    bench::parseSize(argc, argv, 1, width, height);
+    int channels = (argc > 2) ? std::atoi(argv[2]) : 1;
+
+    const Image source = bench::makeSyntheticImage(width, height, channels);
+
+    const std::vector<std::vector<float>> laplacian = {
+        {-1, -1, -1},
+        {-1,  8, -1},
+        {-1, -1, -1}
+    };
+    const std::vector<std::vector<float>> smooth5(5, std::vector<float>(5, 1.0f / 25.0f));
+
+    const char* names[] = {"None", "Zero", "Replicate", "Mirror"};
+    const SpatialTransformation::PaddingType modes[] = {
+        SpatialTransformation::PaddingType::None,
+        SpatialTransformation::PaddingType::Zero,
+        SpatialTransformation::PaddingType::Replicate,
+        SpatialTransformation::PaddingType::Mirror
+    };
+
+    std::printf("%dx%d, %d channel(s), throughput in MP/s\n", width, height, channels);
+    std::printf("%-10s %14s %14s %14s\n", "padding", "conv 3x3", "conv 5x5", "median 5x5");
+
+    for (int m = 0; m < 4; ++m) {
+        Image img;
+        double conv3 = bench::measureMs([&] {
+            img = source;
+            SpatialTransformation::applyConvolution(img, laplacian, modes[m]);
+        });
+        double conv5 = bench::measureMs([&] {
+            img = source;
+            SpatialTransformation::applyConvolution(img, smooth5, modes[m]);
+        });
+        double median5 = bench::measureMs([&] {
+            img = source;
+            SpatialTransformation::applyMedianFilter(img, 5, modes[m]);
+        });
+
+        std::printf("%-10s %14.1f %14.1f %14.1f\n", names[m],
+                    bench::megapixelsPerSecond(width, height, conv3),
+                    bench::megapixelsPerSecond(width, height, conv5),
+                    bench::megapixelsPerSecond(width, height, median5));
+    }
+    return 0;
+}
@@ -0,0 +1,44 @@
+// Compares the full 2-D Gaussian convolution against the separable path used by
+// applyGaussianFilter / applyBoxFilter for kernel sizes 3..31.
+//
+// Usage: separableBenchmark [WIDTHxHEIGHT] [channels]   (default 3840x2160, 1 channel)
+
+#include "BenchUtils.h"
+#include "ImageSpatialTransformation.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace iipt;
+
+int main(int argc, char** argv) {
+    int width = 3840, height = 2160;
+    bench::parseSize(argc, argv, 1, width, height);
+    int channels = (argc > 2) ? std::atoi(argv[2]) : 1;
+
+    const Image source = bench::makeSyntheticImage(width, height, channels);
+    const auto padding = SpatialTransformation::PaddingType::Replicate;
+
+    std::printf("Gaussian filter, %dx%d, %d channel(s), replicate padding\n", width, height, channels);
+    std::printf("%6s %12s %12s %10s %10s\n", "kernel", "2-D [ms]", "sep. [ms]", "speedup", "sep. MP/s");
+
+    for (int size = 3; size <= 31; size += 2) {
+        float sigma = size / 6.0f;
+        auto kernel = SpatialTransformation::generateGaussianKernel(size, sigma);
+
+        Image img;
+        double fullMs = bench::measureMs([&] {
+            img = source;
+            SpatialTransformation::applyConvolution(img, kernel, padding);
+        }, 1);
+        double sepMs = bench::measureMs([&] {
+            img = source;
+            SpatialTransformation::applyGaussianFilter(img, size, sigma, padding);
+        });
+
+        std::printf("%6d %12.1f %12.1f %9.1fx %10.1f\n", size, fullMs, sepMs, fullMs / sepMs,
+                    bench::megapixelsPerSecond(width, height, sepMs));
+    }
+    return 0;
+}
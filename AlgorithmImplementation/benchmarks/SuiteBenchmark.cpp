@@ -0,0 +1,269 @@
+// Benchmark suite over the public operations: intensity transforms, spatial filters
+// (kernel sizes x padding modes), thresholding, morphology (SE shapes x sizes) and BMP
+// I/O, on synthetic 512x512, 2K, 4K and 8K images with 1 and 3 channels.
+//
+// Every case is a BatchProcessor operation spec, so a slow case can be rerun with
+// `mainApp --op <spec>`. Each case gets warmup runs and repeated timed runs on a fresh
+// copy of the input; the median time is reported as megapixels per second.
+//
+// Usage: suiteBenchmark [--sizes 512,2k,4k,8k] [--channels 1,3] [--filter TEXT]
+//                       [--reps N] [--warmup N] [--json OUT] [--baseline FILE]
+//                       [--tolerance FRACTION]
+//
+// With --baseline, cases more than `tolerance` (default 0.10) slower than the stored
+// result are flagged and the exit status is 1. A --json output can serve as the next
+// baseline.
+
+#include "BenchUtils.h"
+#include "BatchProcessor.h"
+#include "ThreadPool.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace iipt;
+
+namespace {
+struct SizePreset { const char* name; int width; int height; };
+const SizePreset kSizes[] = {{"512", 512, 512}, {"2k", 2048, 1080}, {"4k", 3840, 2160}, {"8k", 7680, 4320}};
+
+struct Case {
+    std::string name;                                  // op spec, or bmp-save / bmp-load
+    bool singleChannel = false;                        // only meaningful on 1-channel input
+    bool threeChannel = false;                         // only meaningful on RGB input
+};
+
+struct Result {
+    std::string key;                                   // name/size/cN
+    std::string name;
+    int width, height, channels;
+    bench::TimingStats stats;
+    double mpxPerSec;
+};
+
+std::vector<Case> buildCases() {
+    std::vector<Case> cases;
+    auto add = [&](const std::string& name, bool gray = false, bool rgb = false) { cases.push_back({name, gray, rgb}); };
+
+    // Intensity and histogram
+    for (const char* spec : {"negative", "log:40", "gamma:0.5", "clahe:2:8", "equalize"}) add(spec);
+
+    // Spatial filters across kernel sizes and padding modes
+    const char* paddings[] = {"none", "zero", "replicate", "mirror"};
+    for (const char* pad : paddings) {
+        for (int k : {3, 7, 15}) {
+            std::string ks = std::to_string(k);
+            add("box:" + ks + ":" + pad);
+            add("gaussian:" + ks + ":" + std::to_string(k / 3.0f).substr(0, 4) + ":" + pad);
+            add("median:" + ks + ":" + pad);
+            add("min:" + ks + ":" + pad);
+            add("max:" + ks + ":" + pad);
+            add("percentile:" + ks + ":25:" + pad);
+            add("unsharp:gaussian:" + ks + ":1.5:" + pad);
+            add("highboost:box:" + ks + ":2:" + pad);
+        }
+        add(std::string("laplacian:basic:") + pad);
+        add(std::string("laplacian:full:") + pad);
+        add(std::string("sobel:") + pad);
+        add(std::string("sharpen:full:") + pad);
+    }
+    // Large box kernels: running sums keep the time flat in the kernel size, so growth
+    // here is a regression
+    for (int k : {31, 61, 101}) add("box:" + std::to_string(k) + ":replicate");
+
+    // Conversion and thresholding
+    add("grayscale", false, true);
+    for (const char* spec : {"threshold:128", "otsu", "adaptive-mean:15:2", "adaptive-gaussian:15:2",
+                             "niblack:15", "sauvola:15"})
+        add(spec, true);
+
+    // Morphology across SE shapes and sizes; binary operators need one channel
+    const char* binaryOps[] = {"erosion", "dilation", "opening", "closing", "boundary"};
+    const char* grayOps[] = {"gray-erosion", "gray-dilation", "gray-opening", "gray-closing",
+                             "tophat", "blackhat", "gradient"};
+    for (const char* shape : {"square", "cross", "circle", "line_horizontal", "line_vertical"}) {
+        for (int size : {3, 9, 21}) {
+            std::string suffix = std::string(":") + shape + ":" + std::to_string(size) + ":replicate";
+            for (const char* op : binaryOps) add(op + suffix, true);
+            for (const char* op : grayOps) add(op + suffix);
+        }
+    }
+
+    add("bmp-save");
+    add("bmp-load");
+    return cases;
+}
+
+std::vector<std::string> splitList(const std::string& text) {
+    std::vector<std::string> items;
+    std::stringstream stream(text);
+    std::string item;
+    while (std::getline(stream, item, ',')) items.push_back(item);
+    return items;
+}
+
+std::string jsonEscape(const std::string& text) {
+    std::string out;
+    for (char c : text) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+// One result object per line, so the baseline reader below can stay line based
+void writeJson(const std::string& path, const std::vector<Result>& results) {
+    std::ofstream out(path);
+    if (!out) {
+        std::fprintf(stderr, "Failed to write %s\n", path.c_str());
+        return;
+    }
+    out << "{\n  \"threads\": " << ThreadPool::threadCount() << ",\n  \"results\": [\n";
+    char line[512];
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        std::snprintf(line, sizeof(line),
+                      "    {\"key\": \"%s\", \"name\": \"%s\", \"width\": %d, \"height\": %d, \"channels\": %d, "
+                      "\"repetitions\": %d, \"medianMs\": %.4f, \"minMs\": %.4f, \"meanMs\": %.4f, "
+                      "\"stddevMs\": %.4f, \"mpxPerSec\": %.3f}%s\n",
+                      jsonEscape(r.key).c_str(), jsonEscape(r.name).c_str(), r.width, r.height, r.channels,
+                      r.stats.repetitions, r.stats.medianMs, r.stats.minMs, r.stats.meanMs, r.stats.stddevMs,
+                      r.mpxPerSec, i + 1 < results.size() ? "," : "");
+        out << line;
+    }
+    out << "  ]\n}\n";
+}
+
+// key -> mpxPerSec from a file written by writeJson
+std::map<std::string, double> readBaseline(const std::string& path) {
+    std::map<std::string, double> baseline;
+    std::ifstream in(path);
+    if (!in) {
+        std::fprintf(stderr, "Failed to read baseline %s\n", path.c_str());
+        return baseline;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        size_t key = line.find("\"key\": \"");
+        size_t rate = line.find("\"mpxPerSec\": ");
+        if (key == std::string::npos || rate == std::string::npos) continue;
+        key += 8;
+        std::string name;
+        for (size_t i = key; i < line.size() && line[i] != '"'; ++i) {
+            if (line[i] == '\\' && i + 1 < line.size()) ++i;
+            name += line[i];
+        }
+        baseline[name] = std::atof(line.c_str() + rate + 13);
+    }
+    return baseline;
+}
+} // anonymous namespace
+
+int main(int argc, char** argv) {
+    std::vector<std::string> sizes = {"512", "2k", "4k", "8k"};
+    std::vector<int> channelList = {1, 3};
+    std::string filter, jsonPath, baselinePath;
+    int repetitions = 5, warmups = 1;
+    double tolerance = 0.10;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        std::string arg = argv[i], value = argv[i + 1];
+        if (arg == "--sizes") sizes = splitList(value);
+        else if (arg == "--channels") {
+            channelList.clear();
+            for (const std::string& c : splitList(value)) channelList.push_back(std::atoi(c.c_str()));
+        }
+        else if (arg == "--filter") filter = value;
+        else if (arg == "--reps") repetitions = std::atoi(value.c_str());
+        else if (arg == "--warmup") warmups = std::atoi(value.c_str());
+        else if (arg == "--json") jsonPath = value;
+        else if (arg == "--baseline") baselinePath = value;
+        else if (arg == "--tolerance") tolerance = std::atof(value.c_str());
+        else {
+            std::fprintf(stderr, "Unknown option %s\n", arg.c_str());
+            return 2;
+        }
+    }
+
+    std::map<std::string, double> baseline;
+    if (!baselinePath.empty()) baseline = readBaseline(baselinePath);
+
+    std::string bmpPath = (std::filesystem::temp_directory_path() / "iipt_suite_benchmark.bmp").string();
+    std::vector<Case> cases = buildCases();
+    std::vector<Result> results;
+    int regressions = 0;
+
+    std::printf("%d threads, %d timed runs after %d warmup, median time\n", ThreadPool::threadCount(), repetitions, warmups);
+    std::printf("%-44s %11s %3s %10s %9s %10s %9s\n", "case", "size", "ch", "median ms", "stddev", "MP/s", "baseline");
+
+    for (const SizePreset& size : kSizes) {
+        if (std::find(sizes.begin(), sizes.end(), size.name) == sizes.end()) continue;
+        for (int channels : channelList) {
+            const Image source = bench::makeSyntheticImage(size.width, size.height, channels);
+            Image img;
+
+            for (const Case& c : cases) {
+                if (!filter.empty() && c.name.find(filter) == std::string::npos) continue;
+                if ((c.singleChannel && channels != 1) || (c.threeChannel && channels != 3)) continue;
+
+                std::function<void()> run;
+                std::function<void()> setup = [&] { img = source; };
+                BatchOperation op;
+                if (c.name == "bmp-save") {
+                    run = [&] { img.saveBMP(bmpPath); };
+                } else if (c.name == "bmp-load") {
+                    source.saveBMP(bmpPath);
+                    setup = [] {};
+                    run = [&] { img.loadBMP(bmpPath); };
+                } else if (BatchProcessor::parseOperation(c.name, op)) {
+                    run = [&] { op.apply(img); };
+                } else {
+                    continue;
+                }
+
+                Result r;
+                r.name = c.name;
+                r.width = size.width;
+                r.height = size.height;
+                r.channels = channels;
+                r.key = c.name + "/" + std::to_string(size.width) + "x" + std::to_string(size.height) + "/c" + std::to_string(channels);
+                r.stats = bench::measureStats(setup, run, repetitions, warmups);
+                r.mpxPerSec = bench::megapixelsPerSecond(size.width, size.height, r.stats.medianMs);
+
+                std::string verdict = "-";
+                auto base = baseline.find(r.key);
+                if (base != baseline.end() && base->second > 0.0) {
+                    double change = r.mpxPerSec / base->second - 1.0;
+                    char text[32];
+                    std::snprintf(text, sizeof(text), "%+.1f%%%s", change * 100.0, change < -tolerance ? " SLOWER" : "");
+                    verdict = text;
+                    if (change < -tolerance) ++regressions;
+                } else if (!baseline.empty()) {
+                    verdict = "new";
+                }
+
+                char dims[24];
+                std::snprintf(dims, sizeof(dims), "%dx%d", size.width, size.height);
+                std::printf("%-44s %11s %3d %10.2f %9.2f %10.1f %9s\n", c.name.c_str(), dims, channels,
+                            r.stats.medianMs, r.stats.stddevMs, r.mpxPerSec, verdict.c_str());
+                std::fflush(stdout);
+                results.push_back(r);
+            }
+        }
+    }
+    std::remove(bmpPath.c_str());
+
+    if (!jsonPath.empty()) writeJson(jsonPath, results);
+    if (!baseline.empty()) {
+        std::printf("%d of %zu cases more than %.0f%% slower than %s\n", regressions, results.size(),
+                    tolerance * 100.0, baselinePath.c_str());
+    }
+    return regressions > 0 ? 1 : 0;
+}
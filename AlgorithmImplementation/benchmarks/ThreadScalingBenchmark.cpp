@@ -0,0 +1,70 @@
+// Strong scaling of the SpatialTransformation cores: fixed image, 1..N threads.
+// Every multi-threaded result is compared byte for byte with the 1-thread output.
+//
+// Usage: threadScalingBenchmark [WIDTHxHEIGHT] [maxThreads]   (default 3840x2160, hardware threads)
+
+#include "BenchUtils.h"
+#include "ImageSpatialTransformation.h"
+#include "ThreadPool.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace iipt;
+
+int main(int argc, char** argv) {
+    int width = 3840, height = 2160;
+    bench::parseSize(argc, argv, 1, width, height);
+    int maxThreads = (argc > 2) ? std::atoi(argv[2]) : static_cast<int>(std::thread::hardware_concurrency());
+    if (maxThreads < 1) maxThreads = 1;
+
+    const Image source = bench::makeSyntheticImage(width, height, 3);
+    const auto padding = SpatialTransformation::PaddingType::Replicate;
+
+    struct Operation {
+        std::string name;
+        std::function<void(Image&)> run;
+    };
+    const std::vector<Operation> operations = {
+        {"gaussian 15", [&](Image& img) { SpatialTransformation::applyGaussianFilter(img, 15, 2.5f, padding); }},
+        {"box 31",      [&](Image& img) { SpatialTransformation::applyBoxFilter(img, 31, padding); }},
+        {"median 7",    [&](Image& img) { SpatialTransformation::applyMedianFilter(img, 7, padding); }},
+        {"laplacian",   [&](Image& img) { SpatialTransformation::applyLaplacianFull(img, false, padding); }},
+        {"sobel",       [&](Image& img) { SpatialTransformation::applySobel(img, padding); }},
+        {"sharpening",  [&](Image& img) { SpatialTransformation::applySharpening(img, "Full Laplacian", padding); }},
+        {"unsharp",     [&](Image& img) { SpatialTransformation::applyUnsharpMasking(img, "gaussian", 9, 1.5f, padding); }},
+        {"highboost",   [&](Image& img) { SpatialTransformation::applyHighboostFiltering(img, "box", 9, 2.0f, 1.0f, padding); }},
+    };
+
+    std::printf("%dx%d RGB, replicate padding, 1..%d threads\n", width, height, maxThreads);
+    std::printf("%-12s %8s %10s %9s %11s %s\n", "operation", "threads", "ms", "speedup", "efficiency", "identical");
+
+    bool allIdentical = true;
+    for (const auto& op : operations) {
+        std::vector<unsigned char> reference;
+        double baseMs = 0.0;
+        for (int threads = 1; threads <= maxThreads; threads = (threads < maxThreads && threads * 2 > maxThreads) ? maxThreads : threads * 2) {
+            ThreadPool::setThreadCount(threads);
+            Image img;
+            double ms = bench::measureMs([&] {
+                img = source;
+                op.run(img);
+            });
+            if (threads == 1) {
+                reference = img.data;
+                baseMs = ms;
+            }
+            bool identical = (img.data == reference);
+            allIdentical = allIdentical && identical;
+            std::printf("%-12s %8d %10.1f %8.2fx %10.0f%% %s\n", op.name.c_str(), threads, ms,
+                        baseMs / ms, 100.0 * baseMs / ms / threads, identical ? "yes" : "NO");
+        }
+    }
+
+    ThreadPool::setThreadCount(0);
+    return allIdentical ? 0 : 1;
+}
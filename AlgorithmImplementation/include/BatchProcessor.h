@@ -0,0 +1,81 @@
+#pragma once
+
+#include "ImageIO.h"
+
+#include <cstddef>
+#include <functional>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace iipt {
+
+    // One step of a batch operation chain, parsed from text such as "gaussian:5:1.4:mirror"
+    struct BatchOperation {
+        static constexpr int kWholeImage = -1;
+
+        std::string spec;
+        std::function<void(Image&)> apply;
+        int halo = 0;       // rows above / below an output row it reads, or kWholeImage
+    };
+
+    // Non-interactive processing of many BMP files through a three-stage pipeline:
+    // reader threads load images, worker threads run the operation chain and writer
+    // threads save the results. The stages are connected by bounded queues, so at most
+    // about queueCapacity images per queue (plus one per thread) are in memory at once.
+    class BatchProcessor {
+        public:
+            struct Options {
+                std::vector<std::string> inputs;        // BMP files
+                std::string outputDir;                  // results keep their input file name,
+                                                        // suffixed _1, _2, ... where inputs share one
+                std::vector<BatchOperation> operations;
+                int readers = 2;
+                int workers = 0;                        // 0: ThreadPool::threadCount()
+                int writers = 2;
+                int queueCapacity = 8;
+                int stripRows = 0;                      // > 0: stream files in strips, see run()
+            };
+
+            struct StageStats {
+                std::string name;
+                int threads = 0;
+                size_t items = 0;
+                size_t bytes = 0;                       // decoded pixel bytes handled
+                double spanSeconds = 0.0;               // first start to last finish
+                std::vector<double> latenciesMs;        // one per item
+            };
+
+            struct Report {
+                std::vector<StageStats> stages;         // read, process, write, end-to-end
+                                                        // (process, end-to-end in strip mode)
+                size_t succeeded = 0;
+                size_t failed = 0;
+                double wallSeconds = 0.0;
+
+                // Per-stage throughput and p50 / p90 / p99 / max latency as a table
+                void print(std::ostream& out) const;
+            };
+
+            // Operation syntax is name[:arg...]; see operationHelp(). Errors go to std::cerr.
+            static bool parseOperation(const std::string& spec, BatchOperation& op);
+            static bool parseOperations(const std::vector<std::string>& specs, std::vector<BatchOperation>& ops);
+            // Whitespace-separated operation specs; '#' starts a comment
+            static bool loadJobFile(const std::string& path, std::vector<std::string>& specs);
+            static std::string operationHelp();
+
+            // BMP files named by a directory, a file, or a pattern with * and ? in its last
+            // component (e.g. "scans/*.bmp"), sorted by path
+            static std::vector<std::string> expandInputs(const std::string& pattern);
+
+            // Rows of context the whole chain needs: the sum of the operations' halos, or
+            // BatchOperation::kWholeImage if any of them needs the whole image
+            static int requiredHalo(const std::vector<BatchOperation>& ops);
+
+            // With stripRows > 0 each worker streams whole files through processBMPStrips
+            // with requiredHalo() rows of halo instead of running the read / process / write
+            // pipeline; a chain that needs the whole image is rejected.
+            static Report run(const Options& options);
+    };
+
+} // namespace iipt
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "ImageIO.h"
+#include <cstdint>
+#include <vector>
+
+namespace iipt {
+
+    // Binary mask packed 64 pixels per word. Pixel x of row y is bit (x % 64) of
+    // row(y)[x / 64]; bits past the image width are always zero.
+    class BinaryImage {
+        public:
+            int width;
+            int height;
+            int wordsPerRow;
+            std::vector<uint64_t> bits;
+
+            BinaryImage();
+            BinaryImage(int width, int height);
+
+            // Any non-zero sample becomes 1 (the same test ImageMorphology applies); img must be 1-channel
+            static BinaryImage fromImage(const Image& img);
+            // 1 -> 255, 0 -> 0, single channel
+            Image toImage() const;
+            void toImage(Image& img) const;
+
+            bool get(int x, int y) const {
+                return (bits[static_cast<size_t>(y) * wordsPerRow + (x >> 6)] >> (x & 63)) & 1u;
+            }
+            void set(int x, int y, bool value) {
+                uint64_t& word = bits[static_cast<size_t>(y) * wordsPerRow + (x >> 6)];
+                uint64_t mask = uint64_t(1) << (x & 63);
+                word = value ? (word | mask) : (word & ~mask);
+            }
+
+            uint64_t* row(int y) { return &bits[static_cast<size_t>(y) * wordsPerRow]; }
+            const uint64_t* row(int y) const { return &bits[static_cast<size_t>(y) * wordsPerRow]; }
+
+            // Mask selecting the valid bits of the last word of a row
+            uint64_t lastWordMask() const {
+                int used = width & 63;
+                return used ? ((uint64_t(1) << used) - 1) : ~uint64_t(0);
+            }
+    };
+
+}
@@ -2,6 +2,7 @@
 #define IMAGECONVERTER_H
 
 #include "ImageIO.h"
+#include "ImageLookupTable.h"
 
 namespace iipt {
 
@@ -13,9 +14,13 @@ class RGBToGrayscaleConverter {
 class GrayscaleToBinaryConverter {
     public:
         static void fixedThreshold(Image& img, int threshold);
+        static LookupTable fixedThresholdTable(int threshold);
         static void otsuThreshold(Image& img);
         static void adaptiveMeanThreshold(Image& img, int blockSize, int C);
         static void adaptiveGaussianThreshold(Image& img, int blockSize, int C);
+        // Local mean/standard deviation thresholds (from integral and squared-integral images)
+        static void niblackThreshold(Image& img, int blockSize, float k = -0.2f);                      // T = m + k*s
+        static void sauvolaThreshold(Image& img, int blockSize, float k = 0.5f, float R = 128.0f);    // T = m * (1 + k*(s/R - 1))
 };
 
 } // namespace iipt
@@ -0,0 +1,36 @@
+#ifndef IMAGE_HISTOGRAM_H
+#define IMAGE_HISTOGRAM_H
+
+#include "ImageIO.h"
+#include "ImageLookupTable.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace iipt {
+
+    using Histogram = std::array<uint64_t, 256>;
+
+    class ImageHistogram {
+        public:
+            // Histogram of one channel of an interleaved image
+            static Histogram compute(const Image& img, int channel = 0);
+            // One histogram per channel (R, G, B for RGB images), counted in a single pass
+            static std::vector<Histogram> computePerChannel(const Image& img);
+            // Counting kernel on raw interleaved samples: count / channels pixels, one histogram per channel
+            static std::vector<Histogram> count(const unsigned char* data, size_t count, int channels);
+
+            // Histogram equalization, applied to each channel independently
+            static void equalize(Image& img);
+            // Histogram matching (specification) against a reference image, per channel.
+            // A single-channel reference is used for every channel of img.
+            static void match(Image& img, const Image& reference);
+
+            static LookupTable equalizationTable(const Histogram& hist);
+            static LookupTable matchingTable(const Histogram& source, const Histogram& reference);
+    };
+
+} // namespace iipt
+
+#endif // IMAGE_HISTOGRAM_H
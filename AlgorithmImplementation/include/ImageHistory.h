@@ -0,0 +1,88 @@
+#pragma once
+
+#include "ImageIO.h"
+
+#include <cstddef>
+#include <deque>
+#include <vector>
+
+namespace iipt {
+
+    // Undo / redo history that stores edits as deltas under a memory budget.
+    //
+    // The caller keeps the current image; the history only holds one Delta per edit, the
+    // XOR of the images before and after it (or both images when the size or channel
+    // count changed). XOR of two similar images is mostly zero, and both forms are
+    // run-length encoded, so local edits and binary masks cost a fraction of a full copy.
+    // Undo and redo XOR the current image with the delta, so either direction is one
+    // parallel pass. When the deltas exceed the budget the oldest ones are dropped.
+    class ImageHistory {
+        public:
+            static constexpr size_t kDefaultMemoryBudget = size_t(512) << 20;
+
+            class Delta {
+                public:
+                    size_t bytes() const { return size; }
+                    bool empty() const { return !before.valid(); }
+
+                    struct Shape {
+                        int width = 0, height = 0, channels = 0;
+                        bool valid() const { return width > 0 && height > 0 && channels > 0; }
+                        bool operator==(const Shape& o) const { return width == o.width && height == o.height && channels == o.channels; }
+                    };
+                    // Rows [i * rowsPerChunk, (i + 1) * rowsPerChunk) of one image or XOR
+                    // image, run-length encoded unless that came out larger
+                    struct Chunk {
+                        std::vector<unsigned char> data;
+                        bool encoded = false;
+                    };
+                    struct Frames {
+                        int rowsPerChunk = 0;
+                        std::vector<Chunk> chunks;
+                    };
+
+                private:
+                    friend class ImageHistory;
+                    Shape before, after;
+                    Frames xorFrames;               // same shape: before ^ after
+                    Frames beforeFrames, afterFrames; // shape changed: both images
+                    size_t size = 0;
+            };
+
+            explicit ImageHistory(size_t memoryBudget = kDefaultMemoryBudget);
+
+            // Delta of one edit. Safe to call from any thread, so it can be built next to
+            // the edit itself; the views must stay valid during the call.
+            static Delta encode(const ImageView& before, const ImageView& after);
+
+            // Records an edit made on top of the current image; discards the redo side
+            void push(Delta delta);
+            void clear();
+
+            bool canUndo() const { return cursor > 0; }
+            bool canRedo() const { return cursor < deltas.size(); }
+            size_t undoCount() const { return cursor; }
+            size_t redoCount() const { return deltas.size() - cursor; }
+
+            // Rebuild the image before (undo) or after (redo) the neighbouring edit from the
+            // current one. Return false, leaving the history unchanged, if there is nothing
+            // to undo / redo or `current` does not match the recorded image size.
+            bool undo(const ImageView& current, Image& previous);
+            bool redo(const ImageView& current, Image& next);
+
+            // Oldest deltas are dropped first, then the newest redo ones. A single delta
+            // larger than the budget is not kept at all.
+            void setMemoryBudget(size_t bytes);
+            size_t memoryBudget() const { return budget; }
+            size_t memoryUsed() const { return used; }
+
+        private:
+            void trim();
+
+            std::deque<Delta> deltas;       // [0, cursor) undoable, [cursor, size) redoable
+            size_t cursor = 0;
+            size_t budget;
+            size_t used = 0;
+    };
+
+} // namespace iipt
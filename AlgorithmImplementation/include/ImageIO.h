@@ -3,6 +3,10 @@
 
 #include <string>
 #include <vector>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
 
 namespace iipt {
 
@@ -20,6 +24,144 @@ public:
 
 };
 
+// Read-only, non-owning view of interleaved 8-bit pixels. Rows are `stride` bytes apart
+// (BMP rows are padded to 4 bytes, so stride can exceed width * channels).
+struct ImageView {
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    size_t stride = 0;
+    const unsigned char* data = nullptr;
+
+    bool empty() const { return data == nullptr; }
+    const unsigned char* row(int y) const { return data + static_cast<size_t>(y) * stride; }
+    // Owning copy (drops the row padding)
+    void copyTo(Image& img) const;
+};
+
+// BMP file mapped into memory (mmap / MapViewOfFile), parsed in place. 8-bit top-down
+// files with a grayscale palette are exposed as an ImageView straight over the mapping;
+// everything else is decoded from the mapping into an Image in one parallel pass
+// (24-bit rows use an SSSE3 BGR -> RGB shuffle when the CPU has it).
+class MappedBMP {
+public:
+    MappedBMP() = default;
+    ~MappedBMP();
+    MappedBMP(const MappedBMP&) = delete;
+    MappedBMP& operator=(const MappedBMP&) = delete;
+
+    bool open(const std::string& filename);
+    void close();
+
+    int width() const { return imageWidth; }
+    int height() const { return imageHeight; }
+    int channels() const { return bitDepth == 8 ? 1 : 3; }
+
+    // True if view() can expose the pixels without a copy
+    bool isZeroCopy() const;
+    // Pixels over the mapping, valid until close(); empty unless isZeroCopy()
+    ImageView view() const;
+    // Decoded copy in the usual Image layout (RGB or gray, top-down)
+    bool toImage(Image& img) const;
+
+private:
+    const unsigned char* bytes = nullptr;
+    size_t size = 0;
+    std::vector<unsigned char> buffer;  // file contents when the platform cannot map
+    void* mapping = nullptr;            // platform handle of the mapping
+
+    int imageWidth = 0;
+    int imageHeight = 0;
+    int bitDepth = 0;
+    bool topDown = false;
+    bool grayPalette = false;           // 8-bit palette with entry i == (i, i, i)
+    size_t rowSize = 0;
+    const unsigned char* pixels = nullptr;
+    unsigned char palette[256] = {};    // blue component of each palette entry
+};
+
+// Strip-wise BMP reader for images that do not fit in memory. Rows are handed out top
+// to bottom whatever the file layout; only a bounded staging buffer is held besides
+// the caller's strip. File offsets are 64-bit.
+class BMPStripReader {
+public:
+    bool open(const std::string& filename);
+    void close();
+
+    int width() const { return imageWidth; }
+    int height() const { return imageHeight; }
+    int channels() const { return bitDepth == 8 ? 1 : 3; }
+    int nextRow() const { return next; }
+
+    // Decodes the next `rows` rows (fewer at the bottom) into `strip`. Returns the
+    // number of rows read, 0 once the image is exhausted.
+    int readStrip(Image& strip, int rows);
+    // Decodes rows [y0, y1) into `strip`, independent of the readStrip position
+    bool readRows(int y0, int y1, Image& strip);
+
+private:
+    std::ifstream file;
+    std::vector<unsigned char> raw;
+    int imageWidth = 0;
+    int imageHeight = 0;
+    int bitDepth = 0;
+    bool topDown = false;
+    bool grayPalette = false;
+    uint64_t rowSize = 0;
+    uint64_t pixelOffset = 0;
+    unsigned char palette[256] = {};
+    int next = 0;
+};
+
+// Strip-wise BMP writer: the header is written by open(), then rows are appended top
+// to bottom. Bottom-up files (the default, as saveBMP writes) are filled from the end.
+class BMPStripWriter {
+public:
+    BMPStripWriter() = default;
+    ~BMPStripWriter();
+    BMPStripWriter(const BMPStripWriter&) = delete;
+    BMPStripWriter& operator=(const BMPStripWriter&) = delete;
+
+    bool open(const std::string& filename, int width, int height, int channels, bool topDown = false);
+    // `rows` rows of interleaved pixels (width * channels bytes each)
+    bool writeRows(const unsigned char* pixels, int rows);
+    bool writeStrip(const Image& strip);
+    int nextRow() const { return next; }
+    // False if the file could not be written or not every row was supplied
+    bool close();
+    // Closes and deletes a partly written file
+    void discard();
+
+private:
+    std::ofstream file;
+    std::string path;
+    std::vector<unsigned char> staging;
+    int imageWidth = 0;
+    int imageHeight = 0;
+    int imageChannels = 0;
+    bool topDown = false;
+    uint64_t rowSize = 0;
+    uint64_t pixelOffset = 0;
+    int next = 0;
+};
+
+// Runs `op` over `input` strip by strip and writes the result to `output`, holding about
+// stripRows + 2 * halo rows at a time. Each strip is passed with up to `halo` extra rows
+// above and below (none past the image edge) and op works on it in place; only the
+// strip's own rows are written. The result matches a whole-image run, including the
+// padding at the image edges, only if halo covers every row the output depends on: the
+// kernel radius for a single neighbourhood filter, but the sum of the radii when op
+// chains neighbourhood passes. Opening, closing, top-hat and black-hat run two passes
+// with the structuring element and need twice its radius; unsharp masking and highboost
+// add the blur's radius to whatever runs before them. Operations that use global
+// statistics (histogram equalization, CLAHE, Otsu) cannot be run in strips. op may
+// change the channel count (grayscale); the output takes the channel count of the first
+// processed strip. Rows are written to output + ".tmp", which replaces output only when
+// every row was written, so output may name the input file; on failure no output file is
+// left behind.
+bool processBMPStrips(const std::string& input, const std::string& output, int stripRows, int halo,
+                      const std::function<void(Image&)>& op);
+
 } // namespace iipt
 
 #endif // IMAGE_IO_H
@@ -2,6 +2,7 @@
 #define IMAGE_INTENSITY_TRANSFORMATION_H
 
 #include "ImageIO.h"
+#include "ImageLookupTable.h"
 
 namespace iipt {
 
@@ -10,6 +11,21 @@ public:
     static void applyNegative(Image& img);
     static void applyLog(Image& img, float c);
     static void applyGamma(Image& img, float gamma, float c);
+
+    // Contrast Limited Adaptive Histogram Equalization. The image is split into
+    // tilesX x tilesY tiles; each tile's histogram is clipped at clipLimit times the
+    // uniform bin height, and pixels are mapped by bilinear interpolation between the
+    // equalization LUTs of the four nearest tiles. Channels are processed independently.
+    static void applyCLAHE(Image& img, float clipLimit = 2.0f, int tilesX = 8, int tilesY = 8);
+
+    // Apply any (possibly fused) chain of point operations in one pass, e.g.
+    // applyLookupTable(img, negativeTable().then(gammaTable(g, c)).then(GrayscaleToBinaryConverter::fixedThresholdTable(t)))
+    static void applyLookupTable(Image& img, const LookupTable& table);
+
+    // Lookup tables for the point operations above, for composing with LookupTable::then
+    static LookupTable negativeTable();
+    static LookupTable logTable(float c);
+    static LookupTable gammaTable(float gamma, float c);
 };
 
 } // namespace iipt
@@ -0,0 +1,31 @@
+#ifndef IMAGE_LOOKUP_TABLE_H
+#define IMAGE_LOOKUP_TABLE_H
+
+#include "ImageIO.h"
+#include <array>
+#include <cstddef>
+
+namespace iipt {
+
+    // 256-entry table for an 8-bit point operation (output depends only on the input value).
+    // Point operations compose: a.then(b) is one table that behaves like applying a, then b,
+    // so a whole chain of point operations costs a single pass over Image::data.
+    class LookupTable {
+        public:
+            LookupTable(); // identity
+
+            unsigned char operator[](unsigned char value) const { return table[value]; }
+            unsigned char& operator[](unsigned char value) { return table[value]; }
+
+            LookupTable then(const LookupTable& next) const;
+
+            void apply(Image& img) const;
+            void apply(unsigned char* data, size_t count) const;
+
+        private:
+            std::array<unsigned char, 256> table;
+    };
+
+} // namespace iipt
+
+#endif // IMAGE_LOOKUP_TABLE_H
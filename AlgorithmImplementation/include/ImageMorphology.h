@@ -2,17 +2,41 @@
 
 #include "ImageIO.h"
 #include "ImageUtils.h"
+#include "BinaryImage.h"
+#include "StructuringElement.h"
 
 namespace iipt {
 
+    // Structuring elements convert implicitly from ImageUtils::createStructuringElement
+    // matrices; each operation picks between a per-tap scan and the SE's rectangle
+    // decomposition by estimated cost.
+    //
+    // PaddingType::None behaves like Zero here: taps outside the image read as 0. This is a
+    // deliberate change; the old padded copy read every pixel as 0 for None, so the
+    // result was an all-black image.
     class ImageMorphology {
         
         public:
-            static void erosion(Image& img, const std::vector<std::vector<int>>& se, ImageUtils::PaddingType padding);
-            static void dilation(Image& img, const std::vector<std::vector<int>>& se, ImageUtils::PaddingType padding);
-            static void opening(Image& img, const std::vector<std::vector<int>>& se, ImageUtils::PaddingType padding);
-            static void closing(Image& img, const std::vector<std::vector<int>>& se, ImageUtils::PaddingType padding);
-            static void boundaryExtract(Image& img, const std::vector<std::vector<int>>& se, ImageUtils::PaddingType padding);
+            static void erosion(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding);
+            static void dilation(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding);
+            static void opening(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding);
+            static void closing(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding);
+            static void boundaryExtract(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding);
+
+            // Grayscale: minimum / maximum over the SE taps, per channel
+            static void grayErosion(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding);
+            static void grayDilation(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding);
+            static void grayOpening(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding);
+            static void grayClosing(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding);
+            // image - opening (bright details smaller than the SE), closing - image (dark details)
+            static void topHat(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding);
+            static void blackHat(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding);
+            // dilation - erosion
+            static void morphologicalGradient(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding);
+
+            // Bit-packed masks: word-parallel AND / OR of shifted rows
+            static void erosion(BinaryImage& img, const StructuringElement& se, ImageUtils::PaddingType padding);
+            static void dilation(BinaryImage& img, const StructuringElement& se, ImageUtils::PaddingType padding);
     };
 
 }
@@ -28,11 +28,20 @@ namespace iipt {
             static void applyBoxFilter(Image& img, int kernelSize, PaddingType padding = PaddingType::None);
             static void applyGaussianFilter(Image& img, int kernelSize, float sigma, PaddingType padding = PaddingType::None);
             static void applyMedianFilter(Image& img, int kernelSize, PaddingType padding = PaddingType::None);
+            static void applyMinFilter(Image& img, int kernelSize, PaddingType padding = PaddingType::None);
+            static void applyMaxFilter(Image& img, int kernelSize, PaddingType padding = PaddingType::None);
+            static void applyPercentileFilter(Image& img, int kernelSize, float percentile, PaddingType padding = PaddingType::None); // percentile in [0, 100]
 
             static void applyLaplacianBasic(Image& img, bool inverted = false, PaddingType padding = PaddingType::None);
             static void applyLaplacianFull(Image& img, bool inverted = false, PaddingType padding = PaddingType::None);
             static void applySobel(Image& img, PaddingType padding = PaddingType::None);
 
+            // Generic 2-D convolution with an arbitrary (odd-sized, square) kernel
+            static void applyConvolution(Image& img, const std::vector<std::vector<float>>& kernel, PaddingType padding = PaddingType::None);
+            // Normalised Gaussian weights as used by applyGaussianFilter (2-D, and the 1-D factor of it)
+            static std::vector<std::vector<float>> generateGaussianKernel(int size, float sigma);
+            static std::vector<float> generateGaussianKernel1D(int size, float sigma);
+
             static void applySharpening(Image& img, const std::string& method, PaddingType padding = PaddingType::None);
             static void applyUnsharpMasking(Image& img, const std::string& kernelType, int kernelSize, float sigma = 1.0f, PaddingType padding = PaddingType::None);
             static void applyHighboostFiltering(Image& img, const std::string& kernelType, int kernelSize, float K, float sigma = 1.0f, PaddingType padding = PaddingType::None);
@@ -42,6 +51,8 @@ namespace iipt {
             static std::vector<unsigned char> boxFilterCore(const std::vector<unsigned char>& input, int width, int height, int channels, int kernelSize, PaddingType padding);
             static std::vector<unsigned char> gaussianFilterCore(const std::vector<unsigned char>& input, int width, int height, int channels, int kernelSize, PaddingType padding, float sigma);
             static std::vector<unsigned char> medianFilterCore(const std::vector<unsigned char>& input, int width, int height, int channels, int kernelSize, PaddingType padding);
+            // Histogram-based rank filter (rank 0 = min, window^2 - 1 = max) used by median/min/max/percentile
+            static std::vector<unsigned char> rankFilterCore(const std::vector<unsigned char>& input, int width, int height, int channels, int kernelSize, int rank, PaddingType padding);
 
             static std::vector<unsigned char> laplacianBasicCore(const std::vector<unsigned char>& input, int width, int height, int channels, bool inverted, PaddingType padding);
             static std::vector<unsigned char> laplacianFullCore(const std::vector<unsigned char>& input, int width, int height, int channels, bool inverted, PaddingType padding);
@@ -51,11 +62,17 @@ namespace iipt {
             static std::vector<unsigned char> unsharpMaskingCore(const std::vector<unsigned char>& input, int width, int height, int channels, const std::string& kernelType, int kernelSize, float sigma, PaddingType padding);
             static std::vector<unsigned char> highboostFilteringCore(const std::vector<unsigned char>& input, int width, int height, int channels, const std::string& kernelType, int kernelSize, float K, float sigma, PaddingType padding);
 
-            static std::vector<std::vector<float>> generateGaussianKernel(int size, float sigma);
             static std::vector<unsigned char> convolve(const std::vector<unsigned char>& input,
                                                         int width, int height, int channels,
                                                         const std::vector<std::vector<float>>& kernel,
                                                         PaddingType padding);
+            // Horizontal 1-D pass into a float buffer followed by a vertical 1-D pass;
+            // equivalent to convolve() with the outer product kernelY x kernelX.
+            static std::vector<unsigned char> convolveSeparable(const std::vector<unsigned char>& input,
+                                                                int width, int height, int channels,
+                                                                const std::vector<float>& kernelX,
+                                                                const std::vector<float>& kernelY,
+                                                                PaddingType padding);
 
 
     };
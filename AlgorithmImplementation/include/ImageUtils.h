@@ -1,5 +1,7 @@
 #pragma once
 
+#include "ImageIO.h"
+
 #include <vector>
 #include <string>
 
@@ -17,6 +19,21 @@ namespace iipt {
 
             static PaddingType askPaddingType();  // Helper function to interactively ask user for padding type
 
+            // Border policy shared by the kernels, so none of them needs a padded copy.
+            // borderIndex maps a coordinate that may lie outside [0, n) to the source
+            // coordinate the padding rule reads, or -1 if the position reads as zero
+            // (None / Zero). Mirror reflects about the edge pixel (-1 -> 1, n -> n - 2).
+            static int borderIndex(int i, int n, PaddingType type);
+            // borderIndex for every position in [-before, n + after); entry (i + before)
+            // belongs to position i. One table per axis.
+            static std::vector<int> borderTable(int n, int before, int after, PaddingType type);
+            // Pixels [firstColumn, firstColumn + count) of one padded row of an interleaved
+            // image row `src`. The interior is a single memcpy; only halo pixels go through
+            // the padding rule.
+            static void padRow(const unsigned char* src, int width, int channels,
+                               int firstColumn, int count, PaddingType type, unsigned char* dst);
+
+            // Materialized padded copy, for code that genuinely needs one
             static std::vector<unsigned char> padImage(
                 const std::vector<unsigned char>& data,
                 int width, int height,
@@ -26,6 +43,11 @@ namespace iipt {
             );
             // Generate structuring element with a given shape and size
             static std::vector<std::vector<int>> createStructuringElement(const std::string& shape, int size);
+
+            // Area-average downscale of src to fit within maxWidth x maxHeight, keeping the
+            // aspect ratio; each output pixel is the mean of the source pixels it covers.
+            // An image that already fits is copied unchanged. Used for preview proxies.
+            static Image downscale(const ImageView& src, int maxWidth, int maxHeight);
     };
 
 }
@@ -0,0 +1,100 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Build with -DIIPT_PROFILE=1 (CMake option IIPT_PROFILE) to compile the instrumentation
+// in. Without it every IIPT_PROFILE_* macro expands to nothing and the library carries
+// no timing code; the Profiler API still links but records nothing.
+#ifndef IIPT_PROFILE
+#define IIPT_PROFILE 0
+#endif
+
+namespace iipt {
+
+    // Scoped timers and allocation counters for the core library.
+    //
+    // Public operations open an "op" scope, their internal steps (padding, convolution,
+    // combine, ...) nested "phase" scopes. Each finished scope becomes one Event with its
+    // thread, nesting depth, start and duration. Buffer allocations reported through
+    // IIPT_PROFILE_ALLOC are charged to the innermost open scope on the calling thread and
+    // included in every enclosing scope. Recording is off until setEnabled(true).
+    class Profiler {
+        public:
+            struct Event {
+                const char* name;
+                const char* category;       // "op", "phase" or "io"
+                int thread;
+                int depth;
+                double startUs;             // since the first recorded event after reset()
+                double durationUs;
+                size_t allocations;
+                size_t bytes;
+            };
+
+            struct Summary {
+                std::string name;
+                std::string category;
+                size_t calls = 0;
+                double totalMs = 0.0;
+                double maxMs = 0.0;
+                size_t allocations = 0;
+                size_t bytes = 0;
+            };
+
+            static constexpr bool compiledIn() { return IIPT_PROFILE != 0; }
+            static void setEnabled(bool on);
+            static bool enabled();
+            static void reset();
+
+            // Events are appended as scopes close; eventCount() marks a point to report from
+            static size_t eventCount();
+            static std::vector<Event> events(size_t firstEvent = 0);
+            // Per name totals, slowest first; with thread >= 0 only events recorded on that thread
+            static std::vector<Summary> summary(size_t firstEvent = 0, int thread = -1);
+            // The Event::thread of scopes closed on the calling thread
+            static int currentThread();
+            static void printSummary(std::ostream& out, size_t firstEvent = 0);
+            // Chrome trace-event JSON (chrome://tracing, Perfetto)
+            static bool writeChromeTrace(const std::string& path);
+
+            static void countAllocation(size_t bytes);
+
+            class Scope {
+                public:
+                    Scope(const char* name, const char* category);
+                    ~Scope();
+                    Scope(const Scope&) = delete;
+                    Scope& operator=(const Scope&) = delete;
+
+                private:
+                    friend class Profiler;
+                    const char* name;
+                    const char* category;
+                    Scope* parent = nullptr;
+                    int depth = 0;
+                    bool active = false;
+                    size_t allocations = 0;
+                    size_t bytes = 0;
+                    std::chrono::steady_clock::time_point start;
+            };
+    };
+
+} // namespace iipt
+
+#if IIPT_PROFILE
+#define IIPT_PROFILE_CONCAT_(a, b) a##b
+#define IIPT_PROFILE_CONCAT(a, b) IIPT_PROFILE_CONCAT_(a, b)
+#define IIPT_PROFILE_SCOPE(name) ::iipt::Profiler::Scope IIPT_PROFILE_CONCAT(iiptProfileScope, __LINE__)(name, "op")
+#define IIPT_PROFILE_PHASE(name) ::iipt::Profiler::Scope IIPT_PROFILE_CONCAT(iiptProfileScope, __LINE__)(name, "phase")
+#define IIPT_PROFILE_IO(name) ::iipt::Profiler::Scope IIPT_PROFILE_CONCAT(iiptProfileScope, __LINE__)(name, "io")
+#define IIPT_PROFILE_ALLOC(bytes) ::iipt::Profiler::countAllocation(bytes)
+#else
+#define IIPT_PROFILE_SCOPE(name) ((void)0)
+#define IIPT_PROFILE_PHASE(name) ((void)0)
+#define IIPT_PROFILE_IO(name) ((void)0)
+#define IIPT_PROFILE_ALLOC(bytes) ((void)0)
+#endif
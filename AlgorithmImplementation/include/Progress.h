@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <stdexcept>
+#include <utility>
+
+namespace iipt {
+
+    // Thrown out of an operation whose ProgressToken was cancelled while it ran
+    class OperationCancelled : public std::runtime_error {
+        public:
+            OperationCancelled() : std::runtime_error("Operation cancelled") {}
+    };
+
+    // Progress reporting and cooperative cancellation for one running operation.
+    //
+    // The caller installs the token with a ProgressToken::Scope on the thread that runs
+    // the operation. ThreadPool::parallelFor picks it up: each row loop of a core (a
+    // "pass"; separable filters and compound morphology run several) reports the fraction
+    // of its rows done, bands are skipped once cancel() was called and the pass then
+    // throws OperationCancelled. The image being processed is left partially written in
+    // that case and should be discarded.
+    class ProgressToken {
+        public:
+            // pass counts the row loops started so far (0 for the first), fraction is the
+            // share of the current pass done. Called from worker threads, possibly
+            // concurrently; keep it short and thread-safe.
+            using Callback = std::function<void(int pass, double fraction)>;
+
+            ProgressToken() = default;
+            explicit ProgressToken(Callback callback) : callback(std::move(callback)) {}
+            ProgressToken(const ProgressToken&) = delete;
+            ProgressToken& operator=(const ProgressToken&) = delete;
+
+            // May be called from any thread
+            void cancel() { cancelRequested.store(true); }
+            bool cancelled() const { return cancelRequested.load(std::memory_order_relaxed); }
+            void throwIfCancelled() const { if (cancelled()) throw OperationCancelled(); }
+
+            // Token installed on the calling thread, or nullptr
+            static ProgressToken* current();
+
+            class Scope {
+                public:
+                    explicit Scope(ProgressToken* token);
+                    ~Scope();
+                    Scope(const Scope&) = delete;
+                    Scope& operator=(const Scope&) = delete;
+
+                private:
+                    ProgressToken* previous;
+            };
+
+        private:
+            friend class ThreadPool;
+            // Called by ThreadPool for each top-level parallelFor of the operation
+            void beginPass(int items);
+            void advance(int items);
+
+            Callback callback;
+            std::atomic<bool> cancelRequested{false};
+            std::atomic<int> passes{0};
+            std::atomic<int> passItems{0};
+            std::atomic<int> itemsDone{0};
+    };
+
+} // namespace iipt
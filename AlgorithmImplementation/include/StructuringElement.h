@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace iipt {
+
+    // Structuring element stored as flat tap lists instead of a 0/1 matrix.
+    // Offsets are relative to the anchor (width / 2, height / 2), the same centre
+    // ImageMorphology has always used. Converts implicitly from the matrices returned
+    // by ImageUtils::createStructuringElement, so existing callers keep working.
+    class StructuringElement {
+        public:
+            struct Offset { int dx, dy; };
+
+            // Active taps dx0..dx1 (inclusive) of SE row dy
+            struct Run { int dy, dx0, dx1; };
+
+            // Filled rectangle of active taps, inclusive bounds
+            struct Rect {
+                int dx0, dy0, dx1, dy1;
+                int width() const { return dx1 - dx0 + 1; }
+                int height() const { return dy1 - dy0 + 1; }
+            };
+
+            StructuringElement();
+            StructuringElement(const std::vector<std::vector<int>>& mask);
+
+            int width() const { return cols; }
+            int height() const { return rows; }
+            int centerX() const { return cols / 2; }
+            int centerY() const { return rows / 2; }
+            bool empty() const { return taps.empty(); }
+            size_t size() const { return taps.size(); }
+
+            const std::vector<Offset>& offsets() const { return taps; }
+            const std::vector<Run>& runs() const { return rowRuns; }
+
+            // Filled rectangles whose union is exactly the SE. Erosion / dilation by a union
+            // is the min / max of the erosions / dilations by its parts, and every part is
+            // separable into two line passes. A square or line is a single rectangle, a cross
+            // two, a disk one per distinct row width.
+            const std::vector<Rect>& rectangles() const { return rects; }
+            bool isRectangle() const { return rects.size() == 1; }
+
+            // Tap offsets as element offsets into an interleaved buffer with the given row
+            // stride (in elements) and channel count.
+            std::vector<std::ptrdiff_t> linearOffsets(size_t stride, int channels) const;
+
+        private:
+            int cols;
+            int rows;
+            std::vector<Offset> taps;
+            std::vector<Run> rowRuns;
+            std::vector<Rect> rects;
+    };
+
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace iipt {
+
+    // Process-wide worker pool shared by the algorithm cores.
+    //
+    // Cores split their output rows into contiguous bands with parallelFor(). Every band
+    // reads the shared (unmodified) input, so the halo rows a kernel needs above and below
+    // its band are simply read from there; each output row is computed exactly as in the
+    // single-threaded path, so results do not depend on the thread count.
+    class ThreadPool {
+        public:
+            // Number of threads taking part in parallelFor (the calling thread included).
+            // 0 restores the default: IIPT_NUM_THREADS if set, else the hardware concurrency.
+            // Must not be called while a parallelFor is running.
+            static void setThreadCount(int count);
+            static int threadCount();
+
+            // Run body(bandBegin, bandEnd) over [begin, end) split into bands of at least
+            // minBand items. Blocks until every band is done; the first exception thrown by a
+            // band is rethrown here. Safe to call concurrently and from inside a band.
+            // Reports to the ProgressToken installed on the calling thread, if any, and
+            // throws OperationCancelled once it is cancelled (see Progress.h).
+            static void parallelFor(int begin, int end, const std::function<void(int, int)>& body, int minBand = 1);
+
+            ~ThreadPool();
+
+        private:
+            ThreadPool() = default;
+            static ThreadPool& instance();
+
+            void start(int count);
+            void stop();
+            void workerLoop();
+            bool runOneTask(std::unique_lock<std::mutex>& lock);
+
+            std::mutex mutex;
+            std::condition_variable taskAvailable;
+            std::condition_variable taskFinished;
+            std::deque<std::function<void()>> tasks;
+            std::vector<std::thread> workers;
+            bool stopping = false;
+            int threads = 1;
+    };
+
+} // namespace iipt
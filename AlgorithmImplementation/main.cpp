@@ -1,16 +1,99 @@
 #include "ImageIO.h"
 #include "ImageIntensityTransformation.h"
+#include "ImageHistogram.h"
 #include "ImageSpatialTransformation.h"
 #include "ImageConverter.h"
 #include "ImageMorphology.h"
 #include "ImageUtils.h"
+#include "BatchProcessor.h"
+#include "ThreadPool.h"
+#include "Profiler.h"
 
 #include <iostream>
 #include <string>
+#include <vector>
 
 using namespace iipt;
 
-int main() {
+static void printUsage() {
+    std::cout << "Usage:\n"
+              << "  mainApp                     interactive menu on ../../testImages/test1.bmp\n"
+              << "  mainApp --input <dir|glob|file> [--input ...] --output <dir>\n"
+              << "          [--op <spec>]... [--jobs <file>] [--readers N] [--workers N]\n"
+              << "          [--writers N] [--queue N] [--threads N] [--strip-rows N]\n"
+              << "          [--profile trace.json]\n\n"
+              << BatchProcessor::operationHelp();
+}
+
+// Non-interactive batch mode: every argument pair is an option, operations run in the
+// order given (--jobs files are expanded in place).
+static int runBatch(int argc, char** argv) {
+    BatchProcessor::Options options;
+    std::vector<std::string> specs;
+    std::string tracePath;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            printUsage();
+            return 0;
+        }
+        if (i + 1 >= argc) {
+            std::cerr << "Missing value for " << arg << "\n";
+            return EXIT_FAILURE;
+        }
+        std::string value = argv[++i];
+        try {
+            if (arg == "--input") {
+                std::vector<std::string> files = BatchProcessor::expandInputs(value);
+                options.inputs.insert(options.inputs.end(), files.begin(), files.end());
+            }
+            else if (arg == "--output") options.outputDir = value;
+            else if (arg == "--op") specs.push_back(value);
+            else if (arg == "--jobs") {
+                if (!BatchProcessor::loadJobFile(value, specs)) return EXIT_FAILURE;
+            }
+            else if (arg == "--readers") options.readers = std::stoi(value);
+            else if (arg == "--workers") options.workers = std::stoi(value);
+            else if (arg == "--writers") options.writers = std::stoi(value);
+            else if (arg == "--queue") options.queueCapacity = std::stoi(value);
+            else if (arg == "--strip-rows") options.stripRows = std::stoi(value);
+            else if (arg == "--threads") ThreadPool::setThreadCount(std::stoi(value));
+            else if (arg == "--profile") tracePath = value;
+            else {
+                std::cerr << "Unknown option: " << arg << "\n";
+                printUsage();
+                return EXIT_FAILURE;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Invalid value for " << arg << ": " << value << "\n";
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (options.inputs.empty() || options.outputDir.empty()) {
+        std::cerr << "Batch mode needs at least one input image and --output.\n";
+        return EXIT_FAILURE;
+    }
+    if (!BatchProcessor::parseOperations(specs, options.operations))
+        return EXIT_FAILURE;
+
+    Profiler::setEnabled(!tracePath.empty());
+    BatchProcessor::Report report = BatchProcessor::run(options);
+    report.print(std::cout);
+    if (!tracePath.empty()) {
+        std::cout << "\n";
+        Profiler::printSummary(std::cout);
+        if (Profiler::compiledIn() && Profiler::writeChromeTrace(tracePath))
+            std::cout << "Trace written to: " << tracePath << "\n";
+    }
+    return report.failed == 0 ? 0 : EXIT_FAILURE;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1)
+        return runBatch(argc, argv);
+
     std::string inputFile = "../../testImages/test1.bmp";
     std::string outputFile = "../../resultImages/output.bmp";
 
@@ -25,6 +108,9 @@ int main() {
     std::cout << "Image loaded successfully!\n";
     std::cout << "Width: " << img.width << ", Height: " << img.height << ", Channels: " << img.channels << "\n";
 
+    Profiler::setEnabled(true);
+    size_t profileMark = Profiler::eventCount();
+
     // Image processing options -----------------------------------------------------------------------------------
 
 
@@ -52,6 +138,7 @@ int main() {
                 << "1. Negative Transformation\n"
                 << "2. Log Transformation\n"
                 << "3. Gamma Transformation\n"
+                << "4. CLAHE (Adaptive Histogram Equalization)\n"
                 << "Type the number: ";
 
         int choice2;
@@ -89,6 +176,20 @@ int main() {
             ImageIntensityTransformation::applyGamma(img, gamma, c);
             break;
         }
+        case 4: {
+            float clipLimit;
+            int tiles;
+            std::cout << "Enter clip limit (e.g. 2.0): ";
+            std::cin >> clipLimit;
+            std::cout << "Enter number of tiles per side (e.g. 8): ";
+            std::cin >> tiles;
+            if (std::cin.fail() || clipLimit <= 0 || tiles <= 0) {
+                std::cerr << "Invalid CLAHE parameters.\n";
+                return EXIT_FAILURE;
+            }
+            ImageIntensityTransformation::applyCLAHE(img, clipLimit, tiles, tiles);
+            break;
+        }
         default:
             std::cerr << "Invalid transformation choice.\n";
             return EXIT_FAILURE;
@@ -97,6 +198,35 @@ int main() {
     }
     case 2: {
         // Histogram
+        std::cout << "Choose histogram operation:\n"
+                << "1. Histogram Equalization\n"
+                << "2. Histogram Matching\n"
+                << "Type the number: ";
+
+        int histChoice;
+        std::cin >> histChoice;
+
+        switch (histChoice) {
+        case 1:
+            ImageHistogram::equalize(img);
+            break;
+        case 2: {
+            std::string referenceFile;
+            std::cout << "Enter path of the reference BMP: ";
+            std::cin >> referenceFile;
+
+            Image reference;
+            if (!reference.loadBMP(referenceFile)) {
+                std::cerr << "Failed to load reference image.\n";
+                return EXIT_FAILURE;
+            }
+            ImageHistogram::match(img, reference);
+            break;
+        }
+        default:
+            std::cerr << "Invalid histogram operation.\n";
+            return EXIT_FAILURE;
+        }
         break;
     }
     case 3: {
@@ -124,6 +254,9 @@ int main() {
                     << "1. Box Filter\n"
                     << "2. Gaussian Filter\n"
                     << "3. Median Filter\n"
+                    << "4. Min Filter\n"
+                    << "5. Max Filter\n"
+                    << "6. Percentile Filter\n"
                     << "Type the number: ";
             int type;
             std::cin >> type;
@@ -141,7 +274,16 @@ int main() {
                 SpatialTransformation::applyGaussianFilter(img, kernelSize, sigma, padding);
             } else if (type == 3)
                 SpatialTransformation::applyMedianFilter(img, kernelSize, padding);
-            else {
+            else if (type == 4)
+                SpatialTransformation::applyMinFilter(img, kernelSize, padding);
+            else if (type == 5)
+                SpatialTransformation::applyMaxFilter(img, kernelSize, padding);
+            else if (type == 6) {
+                float percentile;
+                std::cout << "Enter percentile (0-100): ";
+                std::cin >> percentile;
+                SpatialTransformation::applyPercentileFilter(img, kernelSize, percentile, padding);
+            } else {
                 std::cerr << "Invalid filter type.\n";
                 return EXIT_FAILURE;
             }
@@ -284,6 +426,8 @@ int main() {
                     << "2. Otsu's Method\n"
                     << "3. Adaptive Mean Threshold\n"
                     << "4. Adaptive Gaussian Threshold\n"
+                    << "5. Niblack Threshold\n"
+                    << "6. Sauvola Threshold\n"
                     << "Type the number: ";
             int method;
             std::cin >> method;
@@ -317,6 +461,20 @@ int main() {
                 GrayscaleToBinaryConverter::adaptiveGaussianThreshold(img, blockSize, C);
                 break;
             }
+            case 5:
+            case 6: {
+                int blockSize;
+                float k;
+                std::cout << "Enter block size (odd number): ";
+                std::cin >> blockSize;
+                std::cout << "Enter k (typically " << (method == 5 ? "-0.2" : "0.5") << "): ";
+                std::cin >> k;
+                if (method == 5)
+                    GrayscaleToBinaryConverter::niblackThreshold(img, blockSize, k);
+                else
+                    GrayscaleToBinaryConverter::sauvolaThreshold(img, blockSize, k);
+                break;
+            }
             default:
                 std::cerr << "Invalid thresholding method.\n";
                 return EXIT_FAILURE;
@@ -338,6 +496,13 @@ int main() {
                 << "3. Opening\n"
                 << "4. Closing\n"
                 << "5. Boundary Extraction\n"
+                << "6. Grayscale Erosion\n"
+                << "7. Grayscale Dilation\n"
+                << "8. Grayscale Opening\n"
+                << "9. Grayscale Closing\n"
+                << "10. Top-Hat\n"
+                << "11. Black-Hat\n"
+                << "12. Morphological Gradient\n"
                 << "Type the number: ";
 
         int morphChoice;
@@ -373,6 +538,27 @@ int main() {
         case 5:
             ImageMorphology::boundaryExtract(img, se, padding);
             break;
+        case 6:
+            ImageMorphology::grayErosion(img, se, padding);
+            break;
+        case 7:
+            ImageMorphology::grayDilation(img, se, padding);
+            break;
+        case 8:
+            ImageMorphology::grayOpening(img, se, padding);
+            break;
+        case 9:
+            ImageMorphology::grayClosing(img, se, padding);
+            break;
+        case 10:
+            ImageMorphology::topHat(img, se, padding);
+            break;
+        case 11:
+            ImageMorphology::blackHat(img, se, padding);
+            break;
+        case 12:
+            ImageMorphology::morphologicalGradient(img, se, padding);
+            break;
         default:
             std::cerr << "Invalid choice for morphological operation.\n";
             return EXIT_FAILURE;
@@ -388,6 +574,12 @@ int main() {
         break;
     }
 
+    // Per-operation timings when the library was built with IIPT_PROFILE
+    if (Profiler::compiledIn()) {
+        std::cout << "\n";
+        Profiler::printSummary(std::cout, profileMark);
+    }
+
     // Save it back under a new name
     if (!img.saveBMP(outputFile)) {
         std::cerr << "Failed to save BMP file.\n";
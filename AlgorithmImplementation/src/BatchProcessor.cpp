@@ -0,0 +1,619 @@
+#include "BatchProcessor.h"
+#include "ImageIntensityTransformation.h"
+#include "ImageHistogram.h"
+#include "ImageSpatialTransformation.h"
+#include "ImageConverter.h"
+#include "ImageMorphology.h"
+#include "ImageUtils.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+
+namespace iipt {
+
+namespace {
+namespace fs = std::filesystem;
+using Clock = std::chrono::steady_clock;
+
+// FIFO shared by two pipeline stages. push() blocks while the queue is full, pop()
+// blocks while it is empty and returns false once it is closed and drained.
+template <typename T>
+class BoundedQueue {
+public:
+    explicit BoundedQueue(size_t capacity) : capacity(std::max<size_t>(1, capacity)) {}
+
+    void push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return items.size() < capacity; });
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return closed || !items.empty(); });
+        if (items.empty()) return false;
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    void close() {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed = true;
+        notEmpty.notify_all();
+    }
+
+private:
+    size_t capacity;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    bool closed = false;
+};
+
+struct Job {
+    size_t index = 0;
+    Image img;
+    Clock::time_point started;
+};
+
+// Thread-safe accumulation of one stage's StageStats
+class StageRecorder {
+public:
+    StageRecorder(const std::string& name, int threads) { stats.name = name; stats.threads = threads; }
+
+    void record(Clock::time_point begin, Clock::time_point end, size_t bytes) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stats.items == 0 || begin < first) first = begin;
+        if (stats.items == 0 || end > last) last = end;
+        ++stats.items;
+        stats.bytes += bytes;
+        stats.latenciesMs.push_back(std::chrono::duration<double, std::milli>(end - begin).count());
+    }
+
+    BatchProcessor::StageStats finish() {
+        if (stats.items > 0) stats.spanSeconds = std::chrono::duration<double>(last - first).count();
+        return std::move(stats);
+    }
+
+private:
+    std::mutex mutex;
+    BatchProcessor::StageStats stats;
+    Clock::time_point first;
+    Clock::time_point last;
+};
+
+// Nearest-rank percentile of an ascending vector
+double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0.0;
+    size_t rank = static_cast<size_t>(p / 100.0 * sorted.size() + 0.999999);
+    return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+}
+
+std::vector<std::string> split(const std::string& text, char separator) {
+    std::vector<std::string> parts;
+    std::stringstream stream(text);
+    std::string part;
+    while (std::getline(stream, part, separator)) parts.push_back(part);
+    if (!text.empty() && text.back() == separator) parts.emplace_back();
+    return parts;
+}
+
+bool wildcardMatch(const char* pattern, const char* text) {
+    if (*pattern == '\0') return *text == '\0';
+    if (*pattern == '*')
+        return wildcardMatch(pattern + 1, text) || (*text != '\0' && wildcardMatch(pattern, text + 1));
+    if (*text == '\0') return false;
+    return (*pattern == '?' || *pattern == *text) && wildcardMatch(pattern + 1, text + 1);
+}
+
+bool isBMP(const fs::path& path) {
+    std::string ext = path.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return ext == ".bmp";
+}
+
+// Output file of each input: its file name in outputDir. Inputs from different directories
+// can share a file name; each of those gets _1, _2, ... before the extension (skipping
+// names already taken) so no result overwrites another.
+std::vector<std::string> outputPaths(const std::vector<std::string>& inputs, const std::string& outputDir) {
+    std::map<std::string, int> uses;
+    for (const std::string& input : inputs) ++uses[fs::path(input).filename().string()];
+    std::set<std::string> taken;
+    for (const auto& [name, count] : uses) taken.insert(name);
+
+    std::vector<std::string> outputs;
+    for (const std::string& input : inputs) {
+        fs::path leaf = fs::path(input).filename();
+        if (uses[leaf.string()] > 1) {
+            std::string renamed;
+            int n = 0;
+            do {
+                renamed = leaf.stem().string() + "_" + std::to_string(++n) + leaf.extension().string();
+            } while (taken.count(renamed));
+            taken.insert(renamed);
+            std::cerr << "Several inputs are named " << leaf.string() << "; writing " << input
+                      << " as " << renamed << "\n";
+            leaf = renamed;
+        }
+        outputs.push_back((fs::path(outputDir) / leaf).string());
+    }
+    return outputs;
+}
+
+// Positional arguments of one operation spec, with typed accessors that report errors
+class SpecArgs {
+public:
+    SpecArgs(const std::string& spec, std::vector<std::string> args) : spec(spec), args(std::move(args)) {}
+
+    bool ok() const { return valid; }
+
+    int integer(size_t i, int fallback, bool required = false) {
+        if (!present(i, required)) return fallback;
+        try {
+            size_t used = 0;
+            int value = std::stoi(args[i], &used);
+            if (used == args[i].size()) return value;
+        } catch (const std::exception&) {}
+        invalid(i);
+        return fallback;
+    }
+
+    float real(size_t i, float fallback, bool required = false) {
+        if (!present(i, required)) return fallback;
+        try {
+            size_t used = 0;
+            float value = std::stof(args[i], &used);
+            if (used == args[i].size()) return value;
+        } catch (const std::exception&) {}
+        invalid(i);
+        return fallback;
+    }
+
+    std::string word(size_t i, const std::string& fallback, bool required = false) {
+        return present(i, required) ? args[i] : fallback;
+    }
+
+    // none | zero | replicate | mirror, in PaddingType order (same in both padding enums)
+    int padding(size_t i) {
+        static const char* names[] = {"none", "zero", "replicate", "mirror"};
+        std::string name = word(i, "replicate");
+        for (int p = 0; p < 4; ++p)
+            if (name == names[p]) return p;
+        invalid(i);
+        return 2;
+    }
+
+private:
+    // False if argument i is absent; an error only when it is required
+    bool present(size_t i, bool required) {
+        if (i < args.size() && !args[i].empty()) return true;
+        if (required) {
+            std::cerr << "Operation '" << spec << "': missing argument " << (i + 1) << "\n";
+            valid = false;
+        }
+        return false;
+    }
+
+    void invalid(size_t i) {
+        std::cerr << "Operation '" << spec << "': invalid argument '" << args[i] << "'\n";
+        valid = false;
+    }
+
+    std::string spec;
+    std::vector<std::string> args;
+    bool valid = true;
+};
+
+using MorphologyFn = void (*)(Image&, const StructuringElement&, ImageUtils::PaddingType);
+
+const std::map<std::string, MorphologyFn>& morphologyOperations() {
+    static const std::map<std::string, MorphologyFn> ops = {
+        {"erosion", ImageMorphology::erosion},
+        {"dilation", ImageMorphology::dilation},
+        {"opening", ImageMorphology::opening},
+        {"closing", ImageMorphology::closing},
+        {"boundary", ImageMorphology::boundaryExtract},
+        {"gray-erosion", ImageMorphology::grayErosion},
+        {"gray-dilation", ImageMorphology::grayDilation},
+        {"gray-opening", ImageMorphology::grayOpening},
+        {"gray-closing", ImageMorphology::grayClosing},
+        {"tophat", ImageMorphology::topHat},
+        {"blackhat", ImageMorphology::blackHat},
+        {"gradient", ImageMorphology::morphologicalGradient},
+    };
+    return ops;
+}
+} // anonymous namespace
+
+std::string BatchProcessor::operationHelp() {
+    return
+        "Operations (name[:arg...]; pad = none | zero | replicate | mirror, default replicate):\n"
+        "  negative | log:c | gamma:gamma[:c] | clahe[:clip[:tiles]] | equalize\n"
+        "  box:k[:pad] | gaussian:k:sigma[:pad] | median:k[:pad] | min:k[:pad] | max:k[:pad]\n"
+        "  percentile:k:p[:pad] | laplacian:basic|full[:inverted][:pad] | sobel[:pad]\n"
+        "  sharpen:basic|full|basic-inverted|full-inverted|sobel[:pad]\n"
+        "  unsharp:box|gaussian|median:k[:sigma][:pad] | highboost:box|gaussian|median:k:K[:sigma][:pad]\n"
+        "  grayscale | threshold:t | otsu | adaptive-mean:block:C | adaptive-gaussian:block:C\n"
+        "  niblack:block[:k] | sauvola:block[:k]\n"
+        "  erosion | dilation | opening | closing | boundary | gray-erosion | gray-dilation\n"
+        "  gray-opening | gray-closing | tophat | blackhat | gradient   (each :shape:size[:pad];\n"
+        "  shape = square | cross | circle | line_horizontal | line_vertical)\n";
+}
+
+bool BatchProcessor::parseOperation(const std::string& spec, BatchOperation& op) {
+    std::vector<std::string> parts = split(spec, ':');
+    if (parts.empty() || parts[0].empty()) {
+        std::cerr << "Empty operation\n";
+        return false;
+    }
+    std::string name = parts[0];
+    SpecArgs a(spec, std::vector<std::string>(parts.begin() + 1, parts.end()));
+    using Spatial = SpatialTransformation;
+    op.spec = spec;
+
+    // Intensity and histogram
+    if (name == "negative") {
+        op.apply = [](Image& img) { ImageIntensityTransformation::applyNegative(img); };
+    } else if (name == "log") {
+        float c = a.real(0, 1.0f, true);
+        op.apply = [c](Image& img) { ImageIntensityTransformation::applyLog(img, c); };
+    } else if (name == "gamma") {
+        float gamma = a.real(0, 1.0f, true), c = a.real(1, 1.0f);
+        op.apply = [gamma, c](Image& img) { ImageIntensityTransformation::applyGamma(img, gamma, c); };
+    } else if (name == "clahe") {
+        float clip = a.real(0, 2.0f);
+        int tiles = a.integer(1, 8);
+        op.apply = [clip, tiles](Image& img) { ImageIntensityTransformation::applyCLAHE(img, clip, tiles, tiles); };
+        op.halo = BatchOperation::kWholeImage;
+    } else if (name == "equalize") {
+        op.apply = [](Image& img) { ImageHistogram::equalize(img); };
+        op.halo = BatchOperation::kWholeImage;
+    }
+    // Spatial filters
+    else if (name == "box" || name == "median" || name == "min" || name == "max") {
+        int k = a.integer(0, 3, true);
+        auto padding = static_cast<Spatial::PaddingType>(a.padding(1));
+        op.halo = k / 2;
+        if (name == "box") op.apply = [=](Image& img) { Spatial::applyBoxFilter(img, k, padding); };
+        else if (name == "median") op.apply = [=](Image& img) { Spatial::applyMedianFilter(img, k, padding); };
+        else if (name == "min") op.apply = [=](Image& img) { Spatial::applyMinFilter(img, k, padding); };
+        else op.apply = [=](Image& img) { Spatial::applyMaxFilter(img, k, padding); };
+    } else if (name == "gaussian") {
+        int k = a.integer(0, 3, true);
+        float sigma = a.real(1, 1.0f, true);
+        auto padding = static_cast<Spatial::PaddingType>(a.padding(2));
+        op.apply = [=](Image& img) { Spatial::applyGaussianFilter(img, k, sigma, padding); };
+        op.halo = k / 2;
+    } else if (name == "percentile") {
+        int k = a.integer(0, 3, true);
+        float p = a.real(1, 50.0f, true);
+        auto padding = static_cast<Spatial::PaddingType>(a.padding(2));
+        op.apply = [=](Image& img) { Spatial::applyPercentileFilter(img, k, p, padding); };
+        op.halo = k / 2;
+    } else if (name == "laplacian") {
+        std::string variant = a.word(0, "basic", true);
+        bool inverted = a.word(1, "") == "inverted";
+        auto padding = static_cast<Spatial::PaddingType>(a.padding(inverted ? 2 : 1));
+        op.halo = 1;
+        if (variant == "basic") op.apply = [=](Image& img) { Spatial::applyLaplacianBasic(img, inverted, padding); };
+        else if (variant == "full") op.apply = [=](Image& img) { Spatial::applyLaplacianFull(img, inverted, padding); };
+        else { std::cerr << "Operation '" << spec << "': unknown laplacian '" << variant << "'\n"; return false; }
+    } else if (name == "sobel") {
+        auto padding = static_cast<Spatial::PaddingType>(a.padding(0));
+        op.apply = [=](Image& img) { Spatial::applySobel(img, padding); };
+        op.halo = 1;
+    } else if (name == "sharpen") {
+        static const std::map<std::string, std::string> methods = {
+            {"basic", "Basic Laplacian"}, {"full", "Full Laplacian"},
+            {"basic-inverted", "Basic Inverted Laplacian"}, {"full-inverted", "Full Inverted Laplacian"},
+            {"sobel", "Sobel"}};
+        auto method = methods.find(a.word(0, "basic", true));
+        if (method == methods.end()) { std::cerr << "Operation '" << spec << "': unknown sharpening method\n"; return false; }
+        std::string label = method->second;
+        auto padding = static_cast<Spatial::PaddingType>(a.padding(1));
+        op.apply = [=](Image& img) { Spatial::applySharpening(img, label, padding); };
+        op.halo = 1;
+    } else if (name == "unsharp" || name == "highboost") {
+        std::string kernel = a.word(0, "gaussian", true);
+        if (kernel != "box" && kernel != "gaussian" && kernel != "median") {
+            std::cerr << "Operation '" << spec << "': unknown kernel '" << kernel << "'\n";
+            return false;
+        }
+        int k = a.integer(1, 3, true);
+        size_t next = 2;
+        float K = (name == "highboost") ? a.real(next++, 1.0f, true) : 1.0f;
+        float sigma = (kernel == "gaussian") ? a.real(next++, 1.0f) : 1.0f;
+        auto padding = static_cast<Spatial::PaddingType>(a.padding(next));
+        op.halo = k / 2; // the blur; the combine with the original is per pixel
+        if (name == "unsharp") op.apply = [=](Image& img) { Spatial::applyUnsharpMasking(img, kernel, k, sigma, padding); };
+        else op.apply = [=](Image& img) { Spatial::applyHighboostFiltering(img, kernel, k, K, sigma, padding); };
+    }
+    // Conversion and thresholding
+    else if (name == "grayscale") {
+        op.apply = [](Image& img) { RGBToGrayscaleConverter::convert(img); };
+    } else if (name == "threshold") {
+        int t = a.integer(0, 128, true);
+        op.apply = [t](Image& img) { GrayscaleToBinaryConverter::fixedThreshold(img, t); };
+    } else if (name == "otsu") {
+        op.apply = [](Image& img) { GrayscaleToBinaryConverter::otsuThreshold(img); };
+        op.halo = BatchOperation::kWholeImage;
+    } else if (name == "adaptive-mean" || name == "adaptive-gaussian") {
+        int block = a.integer(0, 11, true), C = a.integer(1, 2, true);
+        op.halo = block / 2;
+        if (name == "adaptive-mean") op.apply = [=](Image& img) { GrayscaleToBinaryConverter::adaptiveMeanThreshold(img, block, C); };
+        else op.apply = [=](Image& img) { GrayscaleToBinaryConverter::adaptiveGaussianThreshold(img, block, C); };
+    } else if (name == "niblack") {
+        int block = a.integer(0, 15, true);
+        float k = a.real(1, -0.2f);
+        op.halo = block / 2;
+        op.apply = [=](Image& img) { GrayscaleToBinaryConverter::niblackThreshold(img, block, k); };
+    } else if (name == "sauvola") {
+        int block = a.integer(0, 15, true);
+        float k = a.real(1, 0.5f);
+        op.halo = block / 2;
+        op.apply = [=](Image& img) { GrayscaleToBinaryConverter::sauvolaThreshold(img, block, k); };
+    }
+    // Morphology
+    else if (morphologyOperations().count(name)) {
+        MorphologyFn fn = morphologyOperations().at(name);
+        std::string shape = a.word(0, "square", true);
+        int size = a.integer(1, 3, true);
+        auto padding = static_cast<ImageUtils::PaddingType>(a.padding(2));
+        if (!a.ok()) return false;
+        StructuringElement se = ImageUtils::createStructuringElement(shape, size);
+        if (se.empty()) {
+            std::cerr << "Operation '" << spec << "': invalid structuring element\n";
+            return false;
+        }
+        op.apply = [fn, se, padding](Image& img) { fn(img, se, padding); };
+        // Opening, closing, top-hat and black-hat run two passes with the element
+        static const std::set<std::string> twoPass = {
+            "opening", "closing", "gray-opening", "gray-closing", "tophat", "blackhat"};
+        op.halo = twoPass.count(name) ? 2 * se.centerY() : se.centerY();
+    } else {
+        std::cerr << "Unknown operation '" << name << "'\n";
+        return false;
+    }
+    return a.ok();
+}
+
+bool BatchProcessor::parseOperations(const std::vector<std::string>& specs, std::vector<BatchOperation>& ops) {
+    for (const std::string& spec : specs) {
+        BatchOperation op;
+        if (!parseOperation(spec, op)) return false;
+        ops.push_back(std::move(op));
+    }
+    return true;
+}
+
+int BatchProcessor::requiredHalo(const std::vector<BatchOperation>& ops) {
+    int halo = 0;
+    for (const BatchOperation& op : ops) {
+        if (op.halo == BatchOperation::kWholeImage) return BatchOperation::kWholeImage;
+        halo += op.halo;
+    }
+    return halo;
+}
+
+bool BatchProcessor::loadJobFile(const std::string& path, std::vector<std::string>& specs) {
+    std::ifstream file(path);
+    if (!file) {
+        std::cerr << "Failed to open job file: " << path << "\n";
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream tokens(line);
+        std::string spec;
+        while (tokens >> spec) specs.push_back(spec);
+    }
+    return true;
+}
+
+std::vector<std::string> BatchProcessor::expandInputs(const std::string& pattern) {
+    std::vector<std::string> files;
+    std::error_code ec;
+    fs::path path(pattern);
+    std::string leaf = path.filename().string();
+
+    if (fs::is_directory(path, ec)) {
+        for (const auto& entry : fs::directory_iterator(path, ec))
+            if (entry.is_regular_file(ec) && isBMP(entry.path())) files.push_back(entry.path().string());
+    } else if (leaf.find_first_of("*?") != std::string::npos) {
+        fs::path dir = path.has_parent_path() ? path.parent_path() : fs::path(".");
+        for (const auto& entry : fs::directory_iterator(dir, ec))
+            if (entry.is_regular_file(ec) && wildcardMatch(leaf.c_str(), entry.path().filename().string().c_str()))
+                files.push_back(entry.path().string());
+    } else if (fs::is_regular_file(path, ec)) {
+        files.push_back(pattern);
+    }
+
+    if (files.empty()) std::cerr << "No BMP files match: " << pattern << "\n";
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+BatchProcessor::Report BatchProcessor::run(const Options& options) {
+    Report report;
+    int halo = requiredHalo(options.operations);
+    if (options.stripRows > 0 && halo == BatchOperation::kWholeImage) {
+        std::cerr << "Strip mode cannot run clahe, equalize or otsu; they need the whole image.\n";
+        report.failed = options.inputs.size();
+        return report;
+    }
+
+    std::error_code ec;
+    fs::create_directories(options.outputDir, ec);
+    if (ec) {
+        std::cerr << "Failed to create output directory: " << options.outputDir << "\n";
+        report.failed = options.inputs.size();
+        return report;
+    }
+
+    int readers = std::max(1, options.readers);
+    int workers = options.workers > 0 ? options.workers : ThreadPool::threadCount();
+    int writers = std::max(1, options.writers);
+
+    BoundedQueue<Job> loaded(options.queueCapacity);
+    BoundedQueue<Job> processed(options.queueCapacity);
+    StageRecorder readStage("read", readers);
+    StageRecorder processStage("process", workers);
+    StageRecorder writeStage("write", writers);
+    // Strip mode runs only the workers, each reading, processing and writing its own files
+    StageRecorder totalStage("end-to-end", options.stripRows > 0 ? workers : readers + workers + writers);
+    std::atomic<size_t> nextInput(0);
+    std::atomic<size_t> failed(0);
+    std::atomic<int> readersLeft(readers);
+    std::atomic<int> workersLeft(workers);
+
+    std::vector<std::string> outputs = outputPaths(options.inputs, options.outputDir);
+    if (options.stripRows > 0) {
+        // Strip mode reads an input while its output is written, so the two must differ
+        for (size_t i = 0; i < options.inputs.size(); ++i) {
+            if (fs::equivalent(options.inputs[i], outputs[i], ec)) {
+                std::cerr << "Strip mode cannot write over its input: " << options.inputs[i]
+                          << "; choose another output directory.\n";
+                report.failed = options.inputs.size();
+                return report;
+            }
+        }
+    }
+
+    auto readLoop = [&] {
+        for (size_t i; (i = nextInput.fetch_add(1)) < options.inputs.size();) {
+            Job job;
+            job.index = i;
+            job.started = Clock::now();
+            if (!job.img.loadBMP(options.inputs[i])) {
+                ++failed;
+                continue;
+            }
+            readStage.record(job.started, Clock::now(), job.img.data.size());
+            loaded.push(std::move(job));
+        }
+        if (--readersLeft == 0) loaded.close();
+    };
+
+    auto processLoop = [&] {
+        Job job;
+        while (loaded.pop(job)) {
+            Clock::time_point begin = Clock::now();
+            try {
+                for (const BatchOperation& op : options.operations) op.apply(job.img);
+            } catch (const std::exception& e) {
+                std::cerr << options.inputs[job.index] << ": " << e.what() << "\n";
+                ++failed;
+                continue;
+            }
+            processStage.record(begin, Clock::now(), job.img.data.size());
+            processed.push(std::move(job));
+        }
+        if (--workersLeft == 0) processed.close();
+    };
+
+    // Strip mode: one worker per file, reading, processing and writing it in strips
+    auto stripLoop = [&] {
+        for (size_t i; (i = nextInput.fetch_add(1)) < options.inputs.size();) {
+            Clock::time_point begin = Clock::now();
+            bool ok = false;
+            try {
+                ok = processBMPStrips(options.inputs[i], outputs[i], options.stripRows, halo, [&](Image& strip) {
+                    for (const BatchOperation& op : options.operations) op.apply(strip);
+                });
+            } catch (const std::exception& e) {
+                std::cerr << options.inputs[i] << ": " << e.what() << "\n";
+            }
+            if (!ok) {
+                ++failed;
+                continue;
+            }
+            Clock::time_point end = Clock::now();
+
+            // Bytes of the output image, as in pipeline mode; summing the strips would
+            // count their halo rows again
+            size_t bytes = 0;
+            BMPStripReader written;
+            if (written.open(outputs[i]))
+                bytes = static_cast<size_t>(written.width()) * written.height() * written.channels();
+            processStage.record(begin, end, bytes);
+            totalStage.record(begin, end, bytes);
+        }
+    };
+
+    auto writeLoop = [&] {
+        Job job;
+        while (processed.pop(job)) {
+            Clock::time_point begin = Clock::now();
+            if (!job.img.saveBMP(outputs[job.index])) {
+                ++failed;
+                continue;
+            }
+            Clock::time_point end = Clock::now();
+            writeStage.record(begin, end, job.img.data.size());
+            totalStage.record(job.started, end, job.img.data.size());
+            job.img = Image(); // release pixels before blocking on the queue
+        }
+    };
+
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> threads;
+    if (options.stripRows > 0) {
+        for (int i = 0; i < workers; ++i) threads.emplace_back(stripLoop);
+    } else {
+        for (int i = 0; i < readers; ++i) threads.emplace_back(readLoop);
+        for (int i = 0; i < workers; ++i) threads.emplace_back(processLoop);
+        for (int i = 0; i < writers; ++i) threads.emplace_back(writeLoop);
+    }
+    for (auto& thread : threads) thread.join();
+    report.wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    if (options.stripRows <= 0) report.stages.push_back(readStage.finish());
+    report.stages.push_back(processStage.finish());
+    if (options.stripRows <= 0) report.stages.push_back(writeStage.finish());
+    report.stages.push_back(totalStage.finish());
+    report.succeeded = report.stages.back().items;
+    report.failed = failed.load();
+    return report;
+}
+
+void BatchProcessor::Report::print(std::ostream& out) const {
+    char line[160];
+    std::snprintf(line, sizeof(line), "Processed %zu images (%zu failed) in %.2f s\n", succeeded, failed, wallSeconds);
+    out << line;
+    std::snprintf(line, sizeof(line), "%-11s %7s %7s %9s %9s %9s %9s %9s %9s\n",
+                  "stage", "threads", "items", "img/s", "MB/s", "p50 ms", "p90 ms", "p99 ms", "max ms");
+    out << line;
+    for (const StageStats& stage : stages) {
+        std::vector<double> sorted = stage.latenciesMs;
+        std::sort(sorted.begin(), sorted.end());
+        double span = stage.spanSeconds > 0.0 ? stage.spanSeconds : 1e-9;
+        std::snprintf(line, sizeof(line), "%-11s %7d %7zu %9.1f %9.1f %9.2f %9.2f %9.2f %9.2f\n",
+                      stage.name.c_str(), stage.threads, stage.items,
+                      stage.items / span, stage.bytes / 1.0e6 / span,
+                      percentile(sorted, 50), percentile(sorted, 90), percentile(sorted, 99),
+                      sorted.empty() ? 0.0 : sorted.back());
+        out << line;
+    }
+}
+
+} // namespace iipt
@@ -0,0 +1,58 @@
+#include "BinaryImage.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <iostream>
+
+namespace iipt {
+
+BinaryImage::BinaryImage() : width(0), height(0), wordsPerRow(0) {}
+
+BinaryImage::BinaryImage(int width, int height)
+    : width(width), height(height), wordsPerRow((width + 63) / 64),
+      bits(static_cast<size_t>((width + 63) / 64) * height, 0) {}
+
+BinaryImage BinaryImage::fromImage(const Image& img) {
+    if (img.channels != 1)
+        std::cerr << "BinaryImage::fromImage expects a single-channel image; using the first channel.\n";
+
+    BinaryImage out(img.width, img.height);
+    int channels = img.channels;
+    ThreadPool::parallelFor(0, img.height, [&](int bandBegin, int bandEnd) {
+        for (int y = bandBegin; y < bandEnd; ++y) {
+            const unsigned char* src = &img.data[static_cast<size_t>(y) * img.width * channels];
+            uint64_t* dst = out.row(y);
+            for (int w = 0; w < out.wordsPerRow; ++w) {
+                int x0 = w * 64;
+                int count = std::min(64, img.width - x0);
+                uint64_t word = 0;
+                for (int b = 0; b < count; ++b)
+                    word |= uint64_t(src[(x0 + b) * channels] != 0) << b;
+                dst[w] = word;
+            }
+        }
+    }, 16);
+    return out;
+}
+
+void BinaryImage::toImage(Image& img) const {
+    img.width = width;
+    img.height = height;
+    img.channels = 1;
+    img.data.resize(static_cast<size_t>(width) * height);
+    ThreadPool::parallelFor(0, height, [&](int bandBegin, int bandEnd) {
+        for (int y = bandBegin; y < bandEnd; ++y) {
+            const uint64_t* src = row(y);
+            unsigned char* dst = &img.data[static_cast<size_t>(y) * width];
+            for (int x = 0; x < width; ++x)
+                dst[x] = ((src[x >> 6] >> (x & 63)) & 1u) ? 255 : 0;
+        }
+    }, 16);
+}
+
+Image BinaryImage::toImage() const {
+    Image img;
+    toImage(img);
+    return img;
+}
+
+}
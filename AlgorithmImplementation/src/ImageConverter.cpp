@@ -1,15 +1,21 @@
 #include "ImageConverter.h"
+#include "Profiler.h"
+#include "ImageHistogram.h"
+#include "ThreadPool.h"
 #include <vector>
 #include <cmath>
 #include <algorithm>
+#include <cstdint>
 
 namespace iipt {
 
 // ========== RGB to GRAYSCALE ==========
 void RGBToGrayscaleConverter::convert(Image& img) {
+    IIPT_PROFILE_SCOPE("RGBToGrayscaleConverter::convert");
     if (img.channels != 3) return;
 
     std::vector<unsigned char> gray(img.width * img.height);
+    IIPT_PROFILE_ALLOC(gray.size());
     for (int i = 0; i < img.width * img.height; ++i) {
         int idx = i * 3;
         unsigned char r = img.data[idx];
@@ -24,19 +30,26 @@ void RGBToGrayscaleConverter::convert(Image& img) {
 
 // ========== FIXED THRESHOLD ==========
 void GrayscaleToBinaryConverter::fixedThreshold(Image& img, int threshold) {
+    IIPT_PROFILE_SCOPE("GrayscaleToBinaryConverter::fixedThreshold");
     if (img.channels != 1) return;
 
-    for (auto& px : img.data)
-        px = (px >= threshold) ? 255 : 0;
+    fixedThresholdTable(threshold).apply(img);
+}
+
+LookupTable GrayscaleToBinaryConverter::fixedThresholdTable(int threshold) {
+    LookupTable table;
+    for (int v = 0; v < 256; ++v)
+        table[v] = (v >= threshold) ? 255 : 0;
+    return table;
 }
 
 // ========== OTSU ==========
 void GrayscaleToBinaryConverter::otsuThreshold(Image& img) {
+    IIPT_PROFILE_SCOPE("GrayscaleToBinaryConverter::otsuThreshold");
     if (img.channels != 1) return;
 
     // Compute histogram
-    int hist[256] = {0};
-    for (unsigned char val : img.data) hist[val]++;
+    Histogram hist = ImageHistogram::compute(img);
 
     int total = img.data.size();
     float sum = 0;
@@ -63,69 +76,230 @@ void GrayscaleToBinaryConverter::otsuThreshold(Image& img) {
     }
 
     // Apply threshold
-    for (auto& px : img.data)
-        px = (px >= threshold) ? 255 : 0;
+    fixedThresholdTable(threshold).apply(img);
 }
 
-// ========== ADAPTIVE MEAN ==========
-void GrayscaleToBinaryConverter::adaptiveMeanThreshold(Image& img, int blockSize, int C) {
-    if (img.channels != 1) return;
+// ========== INTEGRAL IMAGES ==========
+namespace {
+// Summed-area table with a zero first row and column: entry (y + 1, x + 1) holds the
+// sum over [0, x] x [0, y]. Arithmetic is modulo 2^bits, which is harmless as long as
+// every rectangle sum read back fits in the accumulator: the wrap-around cancels out.
+template <typename T>
+std::vector<T> integralImage(const std::vector<unsigned char>& data, int width, int height, bool squared) {
+    std::vector<T> table(static_cast<size_t>(width + 1) * (height + 1), 0);
+    IIPT_PROFILE_ALLOC(table.size() * sizeof(T));
+    for (int y = 0; y < height; ++y) {
+        const unsigned char* src = &data[static_cast<size_t>(y) * width];
+        const T* above = &table[static_cast<size_t>(y) * (width + 1)];
+        T* row = &table[static_cast<size_t>(y + 1) * (width + 1)];
+        T running = 0;
+        for (int x = 0; x < width; ++x) {
+            T v = src[x];
+            running += squared ? v * v : v;
+            row[x + 1] = above[x + 1] + running;
+        }
+    }
+    return table;
+}
+
+// Local window statistics over the block clipped to the image, as the brute-force
+// loops computed them: only valid pixels are counted.
+template <typename T>
+struct WindowSums {
+    std::vector<T> sum;
+    std::vector<T> sqSum; // empty unless requested
+    int width, height, half;
+
+    WindowSums(const std::vector<unsigned char>& data, int w, int h, int blockSize, bool withSquares)
+        : sum(integralImage<T>(data, w, h, false)), width(w), height(h), half(blockSize / 2) {
+        if (withSquares) sqSum = integralImage<T>(data, w, h, true);
+    }
+
+    // Rectangle [x0, x1] x [y0, y1] (inclusive) of the window around (x, y)
+    void window(int x, int y, int& x0, int& y0, int& x1, int& y1) const {
+        x0 = std::max(0, x - half);
+        y0 = std::max(0, y - half);
+        x1 = std::min(width - 1, x + half);
+        y1 = std::min(height - 1, y + half);
+    }
 
+    T rect(const std::vector<T>& table, int x0, int y0, int x1, int y1) const {
+        size_t stride = width + 1;
+        return table[(y1 + 1) * stride + (x1 + 1)] - table[y0 * stride + (x1 + 1)]
+             - table[(y1 + 1) * stride + x0]       + table[y0 * stride + x0];
+    }
+};
+
+// Rectangle sums of 8-bit values (and of their squares) fit in 32 bits for windows of up
+// to 4104^2 (256^2 for squares) pixels; larger windows switch to 64-bit tables.
+bool fitsIn32(int blockSize, bool squared) {
+    uint64_t side = 2 * static_cast<uint64_t>(std::max(0, blockSize) / 2) + 1;
+    uint64_t area = side * side;
+    uint64_t maxValue = squared ? 255ull * 255ull : 255ull;
+    return area * maxValue <= 0xFFFFFFFFull;
+}
+
+template <typename T>
+void adaptiveMeanWith(Image& img, int blockSize, int C) {
     std::vector<unsigned char> original = img.data;
+    IIPT_PROFILE_ALLOC(original.size());
     std::vector<unsigned char>& output = img.data;
     int width = img.width, height = img.height;
     output.resize(width * height);
 
-    int half = blockSize / 2;
+    WindowSums<T> sums(original, width, height, blockSize, false);
 
-    for (int y = 0; y < height; ++y)
-        for (int x = 0; x < width; ++x) {
-            int sum = 0, count = 0;
-
-            for (int dy = -half; dy <= half; ++dy)
-                for (int dx = -half; dx <= half; ++dx) {
-                    int nx = x + dx, ny = y + dy;
-                    if (nx >= 0 && nx < width && ny >= 0 && ny < height) {
-                        sum += original[ny * width + nx];
-                        count++;
-                    }
-                }
-
-            int mean = count ? (sum / count) : 0;
-            unsigned char threshold = static_cast<unsigned char>(mean - C);
-            output[y * width + x] = (original[y * width + x] >= threshold) ? 255 : 0;
-        }
+    ThreadPool::parallelFor(0, height, [&](int bandBegin, int bandEnd) {
+        for (int y = bandBegin; y < bandEnd; ++y)
+            for (int x = 0; x < width; ++x) {
+                int x0, y0, x1, y1;
+                sums.window(x, y, x0, y0, x1, y1);
+                int count = (x1 - x0 + 1) * (y1 - y0 + 1);
+                long long sum = static_cast<long long>(sums.rect(sums.sum, x0, y0, x1, y1));
+
+                int mean = count ? static_cast<int>(sum / count) : 0;
+                unsigned char threshold = static_cast<unsigned char>(mean - C);
+                output[y * width + x] = (original[y * width + x] >= threshold) ? 255 : 0;
+            }
+    }, 8);
+}
+
+// Shared driver for Niblack and Sauvola: threshold = rule(mean, standard deviation).
+template <typename T, typename Rule>
+void localStatisticsThreshold(Image& img, int blockSize, Rule rule) {
+    std::vector<unsigned char> original = img.data;
+    IIPT_PROFILE_ALLOC(original.size());
+    std::vector<unsigned char>& output = img.data;
+    int width = img.width, height = img.height;
+
+    WindowSums<T> sums(original, width, height, blockSize, true);
+
+    ThreadPool::parallelFor(0, height, [&](int bandBegin, int bandEnd) {
+        for (int y = bandBegin; y < bandEnd; ++y)
+            for (int x = 0; x < width; ++x) {
+                int x0, y0, x1, y1;
+                sums.window(x, y, x0, y0, x1, y1);
+                double count = static_cast<double>(x1 - x0 + 1) * (y1 - y0 + 1);
+                double mean = static_cast<double>(sums.rect(sums.sum, x0, y0, x1, y1)) / count;
+                double meanSq = static_cast<double>(sums.rect(sums.sqSum, x0, y0, x1, y1)) / count;
+                double stddev = std::sqrt(std::max(0.0, meanSq - mean * mean));
+
+                output[y * width + x] = (original[y * width + x] >= rule(mean, stddev)) ? 255 : 0;
+            }
+    }, 8);
+}
+} // anonymous namespace
+
+// ========== ADAPTIVE MEAN ==========
+void GrayscaleToBinaryConverter::adaptiveMeanThreshold(Image& img, int blockSize, int C) {
+    IIPT_PROFILE_SCOPE("GrayscaleToBinaryConverter::adaptiveMeanThreshold");
+    if (img.channels != 1) return;
+
+    if (fitsIn32(blockSize, false)) adaptiveMeanWith<uint32_t>(img, blockSize, C);
+    else                            adaptiveMeanWith<uint64_t>(img, blockSize, C);
+}
+
+// ========== NIBLACK ==========
+void GrayscaleToBinaryConverter::niblackThreshold(Image& img, int blockSize, float k) {
+    IIPT_PROFILE_SCOPE("GrayscaleToBinaryConverter::niblackThreshold");
+    if (img.channels != 1) return;
+
+    auto rule = [k](double mean, double stddev) { return mean + k * stddev; };
+    if (fitsIn32(blockSize, true)) localStatisticsThreshold<uint32_t>(img, blockSize, rule);
+    else                           localStatisticsThreshold<uint64_t>(img, blockSize, rule);
+}
+
+// ========== SAUVOLA ==========
+void GrayscaleToBinaryConverter::sauvolaThreshold(Image& img, int blockSize, float k, float R) {
+    IIPT_PROFILE_SCOPE("GrayscaleToBinaryConverter::sauvolaThreshold");
+    if (img.channels != 1) return;
+
+    auto rule = [k, R](double mean, double stddev) { return mean * (1.0 + k * (stddev / R - 1.0)); };
+    if (fitsIn32(blockSize, true)) localStatisticsThreshold<uint32_t>(img, blockSize, rule);
+    else                           localStatisticsThreshold<uint64_t>(img, blockSize, rule);
 }
 
 // ========== ADAPTIVE GAUSSIAN ==========
 void GrayscaleToBinaryConverter::adaptiveGaussianThreshold(Image& img, int blockSize, int C) {
+    IIPT_PROFILE_SCOPE("GrayscaleToBinaryConverter::adaptiveGaussianThreshold");
     if (img.channels != 1) return;
 
-    std::vector<unsigned char> original = img.data;
-    std::vector<unsigned char>& output = img.data;
+    // The weight exp(-(dx^2 + dy^2) / 2 sigma^2) factors into g(dx) * g(dy), and the valid
+    // part of a window clipped to the image is a rectangle. So the weighted sum is a
+    // horizontal 1-D pass followed by a vertical one, and the weight total over valid taps
+    // is colWeight[x] * rowWeight[y]. No exp() in the loops, 2 * blockSize taps per pixel.
+    std::vector<unsigned char>& data = img.data;
     int width = img.width, height = img.height;
-    output.resize(width * height);
+    if (width <= 0 || height <= 0) return;
 
     int half = blockSize / 2;
     float sigma = blockSize / 6.0f;
+    int taps = 2 * half + 1;
 
-    for (int y = 0; y < height; ++y)
-        for (int x = 0; x < width; ++x) {
-            float sum = 0, weightSum = 0;
-
-            for (int dy = -half; dy <= half; ++dy)
-                for (int dx = -half; dx <= half; ++dx) {
-                    int nx = x + dx, ny = y + dy;
-                    if (nx >= 0 && nx < width && ny >= 0 && ny < height) {
-                        float weight = std::exp(-(dx * dx + dy * dy) / (2 * sigma * sigma));
-                        sum += original[ny * width + nx] * weight;
-                        weightSum += weight;
-                    }
-                }
-
-            int threshold = (weightSum != 0) ? (sum / weightSum - C) : 0;
-            output[y * width + x] = (original[y * width + x] >= threshold) ? 255 : 0;
+    std::vector<float> g(taps);
+    for (int d = -half; d <= half; ++d)
+        g[d + half] = std::exp(-(d * d) / (2 * sigma * sigma));
+
+    // Sum of the weights that fall inside the image, per column / row
+    auto validWeights = [&](int n) {
+        std::vector<float> total(n, 0.0f);
+        for (int i = 0; i < n; ++i)
+            for (int d = std::max(-half, -i); d <= std::min(half, n - 1 - i); ++d)
+                total[i] += g[d + half];
+        return total;
+    };
+    std::vector<float> colWeight = validWeights(width);
+    std::vector<float> rowWeight = validWeights(height);
+
+    // Horizontal pass
+    std::vector<float> horizontal(static_cast<size_t>(width) * height);
+    IIPT_PROFILE_ALLOC(horizontal.size() * sizeof(float));
+    int interiorX0 = std::min(half, width);
+    int interiorX1 = std::max(interiorX0, width - half);
+    ThreadPool::parallelFor(0, height, [&](int bandBegin, int bandEnd) {
+        for (int y = bandBegin; y < bandEnd; ++y) {
+            const unsigned char* src = &data[static_cast<size_t>(y) * width];
+            float* dst = &horizontal[static_cast<size_t>(y) * width];
+
+            auto borderColumn = [&](int x) {
+                float sum = 0.0f;
+                for (int d = std::max(-half, -x); d <= std::min(half, width - 1 - x); ++d)
+                    sum += src[x + d] * g[d + half];
+                dst[x] = sum;
+            };
+
+            for (int x = 0; x < interiorX0; ++x) borderColumn(x);
+            std::fill(dst + interiorX0, dst + interiorX1, 0.0f);
+            for (int d = -half; d <= half; ++d) {
+                float w = g[d + half];
+                for (int x = interiorX0; x < interiorX1; ++x)
+                    dst[x] += src[x + d] * w;
+            }
+            for (int x = interiorX1; x < width; ++x) borderColumn(x);
+        }
+    }, 8);
+
+    // Vertical pass, then compare against the normalized local mean in place.
+    // Only `horizontal` is read here, so overwriting img.data row by row is safe.
+    ThreadPool::parallelFor(0, height, [&](int bandBegin, int bandEnd) {
+        std::vector<float> acc(width);
+        for (int y = bandBegin; y < bandEnd; ++y) {
+            std::fill(acc.begin(), acc.end(), 0.0f);
+            for (int d = std::max(-half, -y); d <= std::min(half, height - 1 - y); ++d) {
+                const float* src = &horizontal[static_cast<size_t>(y + d) * width];
+                float w = g[d + half];
+                for (int x = 0; x < width; ++x)
+                    acc[x] += src[x] * w;
+            }
+
+            unsigned char* row = &data[static_cast<size_t>(y) * width];
+            for (int x = 0; x < width; ++x) {
+                float weightSum = colWeight[x] * rowWeight[y];
+                int threshold = static_cast<int>(acc[x] / weightSum - C);
+                row[x] = (row[x] >= threshold) ? 255 : 0;
+            }
         }
+    }, 8);
 }
 
 } // namespace iipt
@@ -0,0 +1,173 @@
+#include "ImageHistogram.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <mutex>
+
+namespace iipt {
+
+namespace {
+// Samples per parallel chunk. Each chunk counts into 32-bit private histograms.
+constexpr int kChunkSamples = 1 << 20;
+
+// Counts `count` interleaved samples into `out` (one histogram per channel).
+// Consecutive samples of a channel go to different copies of its histogram (Lanes / channels
+// copies), so runs of equal values do not serialize on a store-to-load dependency on a
+// single counter. The copies are summed at the end.
+template <int Lanes>
+void countLanes(const unsigned char* data, size_t count, int channels, std::vector<Histogram>& out) {
+    uint32_t lanes[Lanes][256] = {};
+    size_t i = 0;
+    for (; i + Lanes <= count; i += Lanes)
+        for (int l = 0; l < Lanes; ++l)
+            ++lanes[l][data[i + l]];
+    for (int l = 0; i < count; ++i, ++l)
+        ++lanes[l][data[i]];
+
+    for (int l = 0; l < Lanes; ++l)
+        for (int v = 0; v < 256; ++v)
+            out[l % channels][v] += lanes[l][v];
+}
+
+void countChunk(const unsigned char* data, size_t count, int channels, std::vector<Histogram>& out) {
+    switch (channels) {
+    case 1: countLanes<4>(data, count, 1, out); break;
+    case 2: countLanes<4>(data, count, 2, out); break;
+    case 3: countLanes<6>(data, count, 3, out); break;
+    case 4: countLanes<8>(data, count, 4, out); break;
+    default:
+        for (size_t i = 0; i < count; ++i)
+            ++out[i % channels][data[i]];
+    }
+}
+
+std::vector<uint64_t> cumulative(const Histogram& hist) {
+    std::vector<uint64_t> cdf(256);
+    uint64_t running = 0;
+    for (int v = 0; v < 256; ++v) {
+        running += hist[v];
+        cdf[v] = running;
+    }
+    return cdf;
+}
+
+// Apply tables[c] to channel c of an interleaved image.
+void applyPerChannel(Image& img, const std::vector<LookupTable>& tables) {
+    if (img.channels == 1) {
+        tables[0].apply(img);
+        return;
+    }
+    int channels = img.channels;
+    size_t pixels = img.data.size() / channels;
+    ThreadPool::parallelFor(0, static_cast<int>((pixels + kChunkSamples - 1) / kChunkSamples), [&](int first, int last) {
+        size_t end = std::min(pixels, static_cast<size_t>(last) * kChunkSamples);
+        for (size_t p = static_cast<size_t>(first) * kChunkSamples; p < end; ++p)
+            for (int c = 0; c < channels; ++c) {
+                unsigned char& v = img.data[p * channels + c];
+                v = tables[c][v];
+            }
+    });
+}
+} // anonymous namespace
+
+std::vector<Histogram> ImageHistogram::count(const unsigned char* data, size_t count, int channels) {
+    channels = std::max(1, channels);
+    std::vector<Histogram> result(channels, Histogram{});
+    std::mutex resultMutex;
+
+    // Keep chunks a multiple of `channels` so every chunk starts on a pixel boundary.
+    size_t chunk = (kChunkSamples / channels) * channels;
+    int chunks = static_cast<int>((count + chunk - 1) / chunk);
+
+    ThreadPool::parallelFor(0, chunks, [&](int first, int last) {
+        std::vector<Histogram> local(channels, Histogram{});
+        for (int c = first; c < last; ++c) {
+            size_t begin = static_cast<size_t>(c) * chunk;
+            countChunk(data + begin, std::min(chunk, count - begin), channels, local);
+        }
+
+        std::lock_guard<std::mutex> lock(resultMutex);
+        for (int ch = 0; ch < channels; ++ch)
+            for (int v = 0; v < 256; ++v)
+                result[ch][v] += local[ch][v];
+    });
+
+    return result;
+}
+
+std::vector<Histogram> ImageHistogram::computePerChannel(const Image& img) {
+    return count(img.data.data(), img.data.size(), img.channels);
+}
+
+Histogram ImageHistogram::compute(const Image& img, int channel) {
+    if (channel < 0 || channel >= img.channels) {
+        std::cerr << "Histogram channel " << channel << " out of range.\n";
+        return Histogram{};
+    }
+    if (img.channels == 1)
+        return count(img.data.data(), img.data.size(), 1)[0];
+    return computePerChannel(img)[channel];
+}
+
+LookupTable ImageHistogram::equalizationTable(const Histogram& hist) {
+    LookupTable table;
+    std::vector<uint64_t> cdf = cumulative(hist);
+    uint64_t total = cdf[255];
+
+    uint64_t cdfMin = 0;
+    for (int v = 0; v < 256; ++v)
+        if (hist[v]) { cdfMin = cdf[v]; break; }
+
+    if (total == cdfMin) return table; // empty or single-valued: nothing to stretch
+
+    for (int v = 0; v < 256; ++v) {
+        double scaled = (cdf[v] < cdfMin) ? 0.0
+                      : static_cast<double>(cdf[v] - cdfMin) / static_cast<double>(total - cdfMin) * 255.0;
+        table[v] = static_cast<unsigned char>(std::clamp(std::lround(scaled), 0L, 255L));
+    }
+    return table;
+}
+
+LookupTable ImageHistogram::matchingTable(const Histogram& source, const Histogram& reference) {
+    LookupTable table;
+    std::vector<uint64_t> srcCdf = cumulative(source);
+    std::vector<uint64_t> refCdf = cumulative(reference);
+    if (srcCdf[255] == 0 || refCdf[255] == 0) return table;
+
+    // Map each value to the smallest reference value whose normalized CDF reaches it.
+    int r = 0;
+    for (int v = 0; v < 256; ++v) {
+        double target = static_cast<double>(srcCdf[v]) / srcCdf[255];
+        while (r < 255 && static_cast<double>(refCdf[r]) / refCdf[255] < target) ++r;
+        table[v] = static_cast<unsigned char>(r);
+    }
+    return table;
+}
+
+void ImageHistogram::equalize(Image& img) {
+    IIPT_PROFILE_SCOPE("ImageHistogram::equalize");
+    std::vector<Histogram> hists = computePerChannel(img);
+    std::vector<LookupTable> tables;
+    for (const Histogram& h : hists)
+        tables.push_back(equalizationTable(h));
+    applyPerChannel(img, tables);
+}
+
+void ImageHistogram::match(Image& img, const Image& reference) {
+    IIPT_PROFILE_SCOPE("ImageHistogram::match");
+    if (reference.channels != 1 && reference.channels != img.channels) {
+        std::cerr << "Histogram matching needs a single-channel reference or one with the same channel count.\n";
+        return;
+    }
+
+    std::vector<Histogram> src = computePerChannel(img);
+    std::vector<Histogram> ref = computePerChannel(reference);
+    std::vector<LookupTable> tables;
+    for (int c = 0; c < img.channels; ++c)
+        tables.push_back(matchingTable(src[c], ref[reference.channels == 1 ? 0 : c]));
+    applyPerChannel(img, tables);
+}
+
+} // namespace iipt
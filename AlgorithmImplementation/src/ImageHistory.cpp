@@ -0,0 +1,262 @@
+#include "ImageHistory.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+namespace iipt {
+
+namespace {
+using Shape = ImageHistory::Delta::Shape;
+using Chunk = ImageHistory::Delta::Chunk;
+using Frames = ImageHistory::Delta::Frames;
+
+// Chunks are encoded and decoded independently, one parallel band each
+constexpr size_t kChunkBytes = size_t(1) << 20;
+// Shorter repeats stay in the literal stream
+constexpr size_t kMinRun = 4;
+
+Shape shapeOf(const ImageView& view) {
+    Shape shape;
+    if (view.empty()) return shape;
+    shape.width = view.width;
+    shape.height = view.height;
+    shape.channels = view.channels;
+    return shape;
+}
+
+void putLength(std::vector<unsigned char>& out, size_t value) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<unsigned char>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+size_t getLength(const unsigned char*& p) {
+    size_t value = 0;
+    for (int shift = 0;; shift += 7) {
+        unsigned char byte = *p++;
+        value |= static_cast<size_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+}
+
+// Byte-wise RLE: a header (length << 1 | 1) followed by one byte is a run, a header
+// (length << 1) is followed by that many literal bytes. Returns false as soon as the
+// encoding is no smaller than the input.
+bool runLengthEncode(const unsigned char* src, size_t n, std::vector<unsigned char>& out) {
+    out.clear();
+    size_t literalStart = 0, i = 0;
+    auto flushLiterals = [&](size_t end) {
+        if (end == literalStart) return;
+        putLength(out, (end - literalStart) << 1);
+        out.insert(out.end(), src + literalStart, src + end);
+    };
+
+    while (i < n) {
+        size_t run = 1;
+        while (i + run < n && src[i + run] == src[i]) ++run;
+        if (run >= kMinRun) {
+            flushLiterals(i);
+            putLength(out, run << 1 | 1);
+            out.push_back(src[i]);
+            literalStart = i + run;
+            if (out.size() >= n) return false;
+        }
+        i += run;
+    }
+    flushLiterals(n);
+    if (out.size() >= n) return false;
+    out.shrink_to_fit();
+    return true;
+}
+
+void runLengthDecode(const std::vector<unsigned char>& encoded, unsigned char* dst) {
+    const unsigned char* p = encoded.data();
+    const unsigned char* end = p + encoded.size();
+    while (p < end) {
+        size_t header = getLength(p);
+        size_t length = header >> 1;
+        if (header & 1) {
+            std::memset(dst, *p++, length);
+        } else {
+            std::memcpy(dst, p, length);
+            p += length;
+        }
+        dst += length;
+    }
+}
+
+// Encodes the rows produced by fillRow(y, dst) in chunks of about kChunkBytes
+template <typename FillRow>
+Frames encodeFrames(const Shape& shape, FillRow fillRow) {
+    Frames frames;
+    size_t rowLen = static_cast<size_t>(shape.width) * shape.channels;
+    frames.rowsPerChunk = static_cast<int>(std::max<size_t>(1, kChunkBytes / rowLen));
+    int chunkCount = (shape.height + frames.rowsPerChunk - 1) / frames.rowsPerChunk;
+    frames.chunks.resize(chunkCount);
+
+    ThreadPool::parallelFor(0, chunkCount, [&](int c0, int c1) {
+        std::vector<unsigned char> buffer;
+        for (int c = c0; c < c1; ++c) {
+            int y0 = c * frames.rowsPerChunk;
+            int y1 = std::min(shape.height, y0 + frames.rowsPerChunk);
+            buffer.resize(rowLen * (y1 - y0));
+            for (int y = y0; y < y1; ++y) fillRow(y, &buffer[rowLen * (y - y0)]);
+
+            Chunk& chunk = frames.chunks[c];
+            chunk.encoded = runLengthEncode(buffer.data(), buffer.size(), chunk.data);
+            if (!chunk.encoded) chunk.data = buffer;
+        }
+    });
+    return frames;
+}
+
+// Writes the image described by `frames` into out; with a base image the frames hold
+// its XOR with the result
+void decodeFrames(const Frames& frames, const Shape& shape, const ImageView* base, Image& out) {
+    size_t rowLen = static_cast<size_t>(shape.width) * shape.channels;
+    out.width = shape.width;
+    out.height = shape.height;
+    out.channels = shape.channels;
+    out.data.resize(rowLen * shape.height);
+    IIPT_PROFILE_ALLOC(out.data.size());
+
+    int chunkCount = static_cast<int>(frames.chunks.size());
+    ThreadPool::parallelFor(0, chunkCount, [&](int c0, int c1) {
+        std::vector<unsigned char> buffer;
+        for (int c = c0; c < c1; ++c) {
+            int y0 = c * frames.rowsPerChunk;
+            int y1 = std::min(shape.height, y0 + frames.rowsPerChunk);
+            const Chunk& chunk = frames.chunks[c];
+            const unsigned char* src = chunk.data.data();
+            if (chunk.encoded) {
+                buffer.resize(rowLen * (y1 - y0));
+                runLengthDecode(chunk.data, buffer.data());
+                src = buffer.data();
+            }
+
+            for (int y = y0; y < y1; ++y, src += rowLen) {
+                unsigned char* dst = &out.data[rowLen * y];
+                if (!base) {
+                    std::memcpy(dst, src, rowLen);
+                    continue;
+                }
+                const unsigned char* b = base->row(y);
+                for (size_t i = 0; i < rowLen; ++i) dst[i] = b[i] ^ src[i];
+            }
+        }
+    });
+}
+
+size_t framesBytes(const Frames& frames) {
+    size_t bytes = 0;
+    for (const Chunk& chunk : frames.chunks) bytes += chunk.data.size() + sizeof(Chunk);
+    return bytes;
+}
+} // anonymous namespace
+
+ImageHistory::ImageHistory(size_t memoryBudget) : budget(memoryBudget) {}
+
+ImageHistory::Delta ImageHistory::encode(const ImageView& before, const ImageView& after) {
+    IIPT_PROFILE_SCOPE("ImageHistory::encode");
+    Delta delta;
+    delta.before = shapeOf(before);
+    delta.after = shapeOf(after);
+    if (!delta.before.valid() || !delta.after.valid()) return Delta();
+
+    size_t rowLen = static_cast<size_t>(before.width) * before.channels;
+    if (delta.before == delta.after) {
+        delta.xorFrames = encodeFrames(delta.before, [&](int y, unsigned char* dst) {
+            const unsigned char* a = before.row(y);
+            const unsigned char* b = after.row(y);
+            for (size_t i = 0; i < rowLen; ++i) dst[i] = a[i] ^ b[i];
+        });
+    } else {
+        delta.beforeFrames = encodeFrames(delta.before, [&](int y, unsigned char* dst) {
+            std::memcpy(dst, before.row(y), rowLen);
+        });
+        size_t afterRowLen = static_cast<size_t>(after.width) * after.channels;
+        delta.afterFrames = encodeFrames(delta.after, [&](int y, unsigned char* dst) {
+            std::memcpy(dst, after.row(y), afterRowLen);
+        });
+    }
+    delta.size = sizeof(Delta) + framesBytes(delta.xorFrames) + framesBytes(delta.beforeFrames) +
+                 framesBytes(delta.afterFrames);
+    return delta;
+}
+
+void ImageHistory::push(Delta delta) {
+    if (delta.empty()) return;
+    while (deltas.size() > cursor) {
+        used -= deltas.back().bytes();
+        deltas.pop_back();
+    }
+    used += delta.bytes();
+    deltas.push_back(std::move(delta));
+    cursor = deltas.size();
+    trim();
+}
+
+void ImageHistory::clear() {
+    deltas.clear();
+    cursor = 0;
+    used = 0;
+}
+
+bool ImageHistory::undo(const ImageView& current, Image& previous) {
+    IIPT_PROFILE_SCOPE("ImageHistory::undo");
+    if (!canUndo()) return false;
+    const Delta& delta = deltas[cursor - 1];
+    if (!(shapeOf(current) == delta.after)) {
+        std::cerr << "Undo: the current image does not match the recorded history.\n";
+        return false;
+    }
+
+    if (delta.before == delta.after)
+        decodeFrames(delta.xorFrames, delta.before, &current, previous);
+    else
+        decodeFrames(delta.beforeFrames, delta.before, nullptr, previous);
+    --cursor;
+    return true;
+}
+
+bool ImageHistory::redo(const ImageView& current, Image& next) {
+    IIPT_PROFILE_SCOPE("ImageHistory::redo");
+    if (!canRedo()) return false;
+    const Delta& delta = deltas[cursor];
+    if (!(shapeOf(current) == delta.before)) {
+        std::cerr << "Redo: the current image does not match the recorded history.\n";
+        return false;
+    }
+
+    if (delta.before == delta.after)
+        decodeFrames(delta.xorFrames, delta.after, &current, next);
+    else
+        decodeFrames(delta.afterFrames, delta.after, nullptr, next);
+    ++cursor;
+    return true;
+}
+
+void ImageHistory::setMemoryBudget(size_t bytes) {
+    budget = bytes;
+    trim();
+}
+
+void ImageHistory::trim() {
+    while (used > budget && cursor > 0) {
+        used -= deltas.front().bytes();
+        deltas.pop_front();
+        --cursor;
+    }
+    while (used > budget && !deltas.empty()) {
+        used -= deltas.back().bytes();
+        deltas.pop_back();
+    }
+}
+
+} // namespace iipt
@@ -1,8 +1,34 @@
 #include "ImageIO.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
 #include <fstream>
 #include <iostream>
 #include <vector>
 #include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <algorithm>
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#elif defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define IIPT_HAVE_MMAP 1
+#endif
+
+// SSSE3 is picked at run time, so the library still builds for the x86-64 baseline
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#define IIPT_HAVE_SSSE3_DISPATCH 1
+#endif
 
 namespace iipt {
 
@@ -28,103 +54,412 @@ struct BMPHeader {
 };
 #pragma pack(pop)
 
+namespace {
+// Swap B and R of `count` 3-byte pixels
+void bgrToRgbScalar(const unsigned char* src, unsigned char* dst, int count) {
+    for (int x = 0; x < count; ++x) {
+        dst[3 * x + 0] = src[3 * x + 2];
+        dst[3 * x + 1] = src[3 * x + 1];
+        dst[3 * x + 2] = src[3 * x + 0];
+    }
+}
+
+#ifdef IIPT_HAVE_SSSE3_DISPATCH
+// Five pixels (15 bytes) per 16-byte shuffle. The 16th byte written is rewritten by the
+// next step, so the vector loop stops while a full 16-byte load and store still fit.
+__attribute__((target("ssse3")))
+void bgrToRgbSSSE3(const unsigned char* src, unsigned char* dst, int count) {
+    const __m128i swap = _mm_setr_epi8(2, 1, 0, 5, 4, 3, 8, 7, 6, 11, 10, 9, 14, 13, 12, 15);
+    int bytes = count * 3;
+    int i = 0;
+    for (; i + 16 <= bytes; i += 15) {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_shuffle_epi8(v, swap));
+    }
+    bgrToRgbScalar(src + i, dst + i, (bytes - i) / 3);
+}
+#endif
+
+using BgrToRgbFn = void (*)(const unsigned char*, unsigned char*, int);
+
+BgrToRgbFn selectBgrToRgb() {
+#ifdef IIPT_HAVE_SSSE3_DISPATCH
+    if (__builtin_cpu_supports("ssse3")) return bgrToRgbSSSE3;
+#endif
+    return bgrToRgbScalar;
+}
+
+// B <-> R swap of one row; the swap is its own inverse, so encoding uses it too
+void swapRedBlue(const unsigned char* src, unsigned char* dst, int count) {
+    static const BgrToRgbFn swap = selectBgrToRgb();
+    swap(src, dst, count);
+}
+
+// Geometry and palette of an uncompressed 8/24-bit BMP
+struct BMPLayout {
+    int width = 0;
+    int height = 0;
+    int bitDepth = 0;
+    bool topDown = false;
+    bool grayPalette = false;          // 8-bit palette with entry i == (i, i, i)
+    uint64_t rowSize = 0;              // file row length, padded to 4 bytes
+    uint64_t pixelOffset = 0;
+    unsigned char palette[256] = {};   // blue component of each palette entry
+};
+
+// Validates the header held in the first `available` bytes of a file of `fileSize`
+// bytes. `available` must cover the palette (bfOffBits bytes) when the file has one.
+bool parseBMPHeader(const unsigned char* bytes, size_t available, uint64_t fileSize,
+                    const std::string& filename, BMPLayout& layout) {
+    if (available < sizeof(BMPHeader)) {
+        std::cerr << "Unsupported BMP format\n";
+        return false;
+    }
+    BMPHeader header;
+    std::memcpy(&header, bytes, sizeof(BMPHeader));
+
+    if (header.bfType != 0x4D42 || header.biCompression != 0) {
+        std::cerr << "Unsupported BMP format\n";
+        return false;
+    }
+    if (header.biBitCount != 8 && header.biBitCount != 24) {
+        std::cerr << "Unsupported bit depth: " << header.biBitCount << "\n";
+        return false;
+    }
+
+    layout.width = header.biWidth;
+    layout.height = std::abs(header.biHeight);
+    layout.topDown = header.biHeight < 0;
+    layout.bitDepth = header.biBitCount;
+    layout.rowSize = ((static_cast<uint64_t>(std::max(layout.width, 0)) * (layout.bitDepth / 8) + 3) / 4) * 4;
+    layout.pixelOffset = header.bfOffBits;
+
+    if (layout.width < 0 || layout.pixelOffset > fileSize
+        || layout.rowSize * layout.height > fileSize - layout.pixelOffset) {
+        std::cerr << "Truncated BMP file: " << filename << "\n";
+        return false;
+    }
+
+    if (layout.bitDepth == 8) {
+        // Gray value of each index: the blue component (R = G = B in a grayscale palette)
+        size_t paletteOffset = 14 + static_cast<size_t>(header.biSize);
+        size_t paletteEnd = std::min<size_t>(header.bfOffBits, available);
+        size_t entries = header.biClrUsed ? std::min<size_t>(header.biClrUsed, 256) : 256;
+        entries = std::min(entries, (std::max(paletteEnd, paletteOffset) - paletteOffset) / 4);
+
+        layout.grayPalette = (entries == 256);
+        for (size_t i = 0; i < entries; ++i) {
+            const unsigned char* entry = bytes + paletteOffset + 4 * i;
+            layout.palette[i] = entry[0];
+            layout.grayPalette = layout.grayPalette && entry[0] == i && entry[1] == i && entry[2] == i;
+        }
+        for (size_t i = entries; i < 256; ++i) layout.palette[i] = 0;
+    }
+    return true;
+}
+
+// One file row to one Image row (RGB or gray)
+void decodeRow(const unsigned char* src, unsigned char* dst, int width, int bitDepth,
+               bool grayPalette, const unsigned char* palette) {
+    if (bitDepth == 24)
+        swapRedBlue(src, dst, width);
+    else if (grayPalette)
+        std::memcpy(dst, src, width);
+    else
+        for (int x = 0; x < width; ++x) dst[x] = palette[src[x]];
+}
+} // anonymous namespace
+
 Image::Image() : width(0), height(0), channels(3) {}
 
 bool Image::loadBMP(const std::string& filename) {
-    std::ifstream file(filename, std::ios::binary);
+    IIPT_PROFILE_IO("Image::loadBMP");
+    MappedBMP file;
+    return file.open(filename) && file.toImage(*this);
+}
+
+void ImageView::copyTo(Image& img) const {
+    img.width = width;
+    img.height = height;
+    img.channels = channels;
+    size_t rowLen = static_cast<size_t>(width) * channels;
+    img.data.resize(rowLen * height);
+    for (int y = 0; y < height; ++y)
+        std::memcpy(&img.data[rowLen * y], row(y), rowLen);
+}
+
+MappedBMP::~MappedBMP() {
+    close();
+}
+
+void MappedBMP::close() {
+#if defined(IIPT_HAVE_MMAP)
+    if (mapping) munmap(mapping, size);
+#elif defined(_WIN32)
+    if (mapping) UnmapViewOfFile(mapping);
+#endif
+    mapping = nullptr;
+    buffer.clear();
+    bytes = nullptr;
+    size = 0;
+    pixels = nullptr;
+    imageWidth = imageHeight = bitDepth = 0;
+    topDown = grayPalette = false;
+    rowSize = 0;
+}
+
+bool MappedBMP::open(const std::string& filename) {
+    close();
+
+#if defined(IIPT_HAVE_MMAP)
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0 || st.st_size <= 0) {
+        if (fd >= 0) ::close(fd);
+        std::cerr << "Failed to open BMP file: " << filename << "\n";
+        return false;
+    }
+    void* mapped = mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        std::cerr << "Failed to map BMP file: " << filename << "\n";
+        return false;
+    }
+    madvise(mapped, static_cast<size_t>(st.st_size), MADV_SEQUENTIAL);
+    mapping = mapped;
+    bytes = static_cast<const unsigned char*>(mapped);
+    size = static_cast<size_t>(st.st_size);
+#elif defined(_WIN32)
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    LARGE_INTEGER fileSize;
+    if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0) {
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        std::cerr << "Failed to open BMP file: " << filename << "\n";
+        return false;
+    }
+    HANDLE section = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    CloseHandle(file);
+    void* mapped = section ? MapViewOfFile(section, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (section) CloseHandle(section); // the view keeps the section alive
+    if (!mapped) {
+        std::cerr << "Failed to map BMP file: " << filename << "\n";
+        return false;
+    }
+    mapping = mapped;
+    bytes = static_cast<const unsigned char*>(mapped);
+    size = static_cast<size_t>(fileSize.QuadPart);
+#else
+    std::ifstream file(filename, std::ios::binary | std::ios::ate);
     if (!file) {
         std::cerr << "Failed to open BMP file: " << filename << "\n";
         return false;
     }
+    buffer.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+    bytes = buffer.data();
+    size = buffer.size();
+#endif
 
-    BMPHeader header;
-    file.read(reinterpret_cast<char*>(&header), sizeof(BMPHeader));
-
-    if (header.bfType != 0x4D42 || header.biCompression != 0) {
-        std::cerr << "Unsupported BMP format\n";
+    BMPLayout layout;
+    if (!parseBMPHeader(bytes, size, size, filename, layout)) {
+        close();
         return false;
     }
+    imageWidth = layout.width;
+    imageHeight = layout.height;
+    bitDepth = layout.bitDepth;
+    topDown = layout.topDown;
+    grayPalette = layout.grayPalette;
+    rowSize = static_cast<size_t>(layout.rowSize);
+    pixels = bytes + layout.pixelOffset;
+    std::memcpy(palette, layout.palette, sizeof(palette));
+    return true;
+}
 
-    width = header.biWidth;
-    height = std::abs(header.biHeight);
-    bool isTopDown = header.biHeight < 0;
+bool MappedBMP::isZeroCopy() const {
+    return pixels && bitDepth == 8 && topDown && grayPalette;
+}
 
-    const uint16_t bitDepth = header.biBitCount;
+ImageView MappedBMP::view() const {
+    ImageView v;
+    if (!isZeroCopy()) return v;
+    v.width = imageWidth;
+    v.height = imageHeight;
+    v.channels = 1;
+    v.stride = rowSize;
+    v.data = pixels;
+    return v;
+}
 
-    if (bitDepth == 24) {
-        channels = 3;
-        int rowSize = ((width * 3 + 3) / 4) * 4;
-        data.resize(width * height * channels);
-        std::vector<unsigned char> row(rowSize);
+bool MappedBMP::toImage(Image& img) const {
+    if (!pixels) return false;
 
-        for (int y = 0; y < height; ++y) {
-            file.read(reinterpret_cast<char*>(row.data()), rowSize);
-            int rowIdx = isTopDown ? y : (height - 1 - y);
-            for (int x = 0; x < width; ++x) {
-                int src = x * 3;
-                int dst = (rowIdx * width + x) * channels;
-                data[dst + 0] = row[src + 2]; // R
-                data[dst + 1] = row[src + 1]; // G
-                data[dst + 2] = row[src + 0]; // B
-            }
+    img.width = imageWidth;
+    img.height = imageHeight;
+    img.channels = channels();
+    size_t rowLen = static_cast<size_t>(imageWidth) * img.channels;
+    img.data.resize(rowLen * imageHeight);
+    IIPT_PROFILE_ALLOC(img.data.size());
+
+    ThreadPool::parallelFor(0, imageHeight, [&](int bandBegin, int bandEnd) {
+        for (int y = bandBegin; y < bandEnd; ++y) {
+            int fileRow = topDown ? y : (imageHeight - 1 - y);
+            decodeRow(pixels + rowSize * fileRow, &img.data[rowLen * y], imageWidth, bitDepth, grayPalette, palette);
         }
+    }, 16);
+    return true;
+}
+
+
+bool Image::saveBMP(const std::string& filename) const {
+    IIPT_PROFILE_IO("Image::saveBMP");
+    BMPStripWriter writer;
+    if (!writer.open(filename, width, height, channels)) return false;
+    return writer.writeRows(data.data(), height) && writer.close();
+}
+
+// Rows go through a bounded staging buffer in blocks of this many
+static const int kStripIOBlockRows = 64;
+
+bool BMPStripReader::open(const std::string& filename) {
+    close();
+    file.open(filename, std::ios::binary | std::ios::ate);
+    if (!file) {
+        std::cerr << "Failed to open BMP file: " << filename << "\n";
+        return false;
     }
-    else if (bitDepth == 8) {
-        channels = 1;
-
-        // Read 256-color palette (1024 bytes)
-        std::vector<uint8_t> colorTable(1024);
-        file.read(reinterpret_cast<char*>(colorTable.data()), 1024);
-
-        int rowSize = ((width + 3) / 4) * 4; // 1 byte per pixel
-        data.resize(width * height);
-        std::vector<uint8_t> row(rowSize);
-
-        for (int y = 0; y < height; ++y) {
-            file.read(reinterpret_cast<char*>(row.data()), rowSize);
-            int rowIdx = isTopDown ? y : (height - 1 - y);
-            for (int x = 0; x < width; ++x) {
-                uint8_t index = row[x];
-                // You can extract RGB from palette here if needed
-                // For now, we assume grayscale palette (R=G=B)
-                data[rowIdx * width + x] = colorTable[index * 4]; // Just take the blue channel (same for R/G/B in grayscale)
-            }
+    uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+
+    // Header first, then everything up to the pixel data so the palette is available
+    std::vector<unsigned char> head(sizeof(BMPHeader));
+    file.seekg(0);
+    file.read(reinterpret_cast<char*>(head.data()), head.size());
+    if (file) {
+        BMPHeader header;
+        std::memcpy(&header, head.data(), sizeof(BMPHeader));
+        size_t headLen = std::min<uint64_t>(std::min<uint64_t>(header.bfOffBits, fileSize), 64 * 1024);
+        if (headLen > head.size()) {
+            head.resize(headLen);
+            file.read(reinterpret_cast<char*>(head.data()) + sizeof(BMPHeader), headLen - sizeof(BMPHeader));
         }
     }
-    else {
-        std::cerr << "Unsupported bit depth: " << bitDepth << "\n";
+
+    if (!file) {
+        std::cerr << "Unsupported BMP format\n";
+        close();
+        return false;
+    }
+    BMPLayout layout;
+    if (!parseBMPHeader(head.data(), head.size(), fileSize, filename, layout)) {
+        close();
+        return false;
+    }
+    imageWidth = layout.width;
+    imageHeight = layout.height;
+    bitDepth = layout.bitDepth;
+    topDown = layout.topDown;
+    grayPalette = layout.grayPalette;
+    rowSize = layout.rowSize;
+    pixelOffset = layout.pixelOffset;
+    std::memcpy(palette, layout.palette, sizeof(palette));
+    return true;
+}
+
+void BMPStripReader::close() {
+    if (file.is_open()) file.close();
+    file.clear();
+    raw.clear();
+    raw.shrink_to_fit();
+    imageWidth = imageHeight = bitDepth = 0;
+    topDown = grayPalette = false;
+    rowSize = pixelOffset = 0;
+    next = 0;
+}
+
+int BMPStripReader::readStrip(Image& strip, int rows) {
+    int count = std::min(rows, imageHeight - next);
+    if (count <= 0 || !readRows(next, next + count, strip)) return 0;
+    next += count;
+    return count;
+}
+
+bool BMPStripReader::readRows(int y0, int y1, Image& strip) {
+    if (!file.is_open() || y0 < 0 || y1 > imageHeight || y0 > y1) {
+        std::cerr << "BMPStripReader: rows " << y0 << ".." << y1 << " out of range\n";
         return false;
     }
 
+    strip.width = imageWidth;
+    strip.height = y1 - y0;
+    strip.channels = channels();
+    size_t rowLen = static_cast<size_t>(imageWidth) * strip.channels;
+    strip.data.resize(rowLen * strip.height);
+
+    raw.resize(rowSize * std::min(kStripIOBlockRows, strip.height));
+    for (int b0 = y0; b0 < y1; b0 += kStripIOBlockRows) {
+        int b1 = std::min(b0 + kStripIOBlockRows, y1);
+        int count = b1 - b0;
+        // Image rows b0..b1 are contiguous in the file in either layout, reversed when bottom-up
+        uint64_t firstFileRow = topDown ? b0 : imageHeight - b1;
+        file.seekg(static_cast<std::streamoff>(pixelOffset + firstFileRow * rowSize));
+        file.read(reinterpret_cast<char*>(raw.data()), static_cast<std::streamsize>(rowSize * count));
+        if (!file) {
+            std::cerr << "BMPStripReader: read failed at row " << b0 << "\n";
+            file.clear();
+            return false;
+        }
+        for (int i = 0; i < count; ++i) {
+            int y = topDown ? b0 + i : b1 - 1 - i;
+            decodeRow(&raw[rowSize * i], &strip.data[rowLen * (y - y0)], imageWidth, bitDepth, grayPalette, palette);
+        }
+    }
     return true;
 }
 
+BMPStripWriter::~BMPStripWriter() {
+    if (file.is_open()) close();
+}
 
-bool Image::saveBMP(const std::string& filename) const {
-    std::ofstream file(filename, std::ios::binary);
+bool BMPStripWriter::open(const std::string& filename, int width, int height, int channels, bool topDown) {
+    if (file.is_open()) close();
+    if (channels != 1 && channels != 3) {
+        std::cerr << "Failed to save BMP file: " << filename << " (" << channels << " channels)\n";
+        return false;
+    }
+    file.open(filename, std::ios::binary | std::ios::trunc);
     if (!file) {
         std::cerr << "Failed to save BMP file: " << filename << "\n";
         return false;
     }
 
-    int rowSize = (channels == 3)
-                    ? ((width * 3 + 3) / 4) * 4
-                    : ((width + 3) / 4) * 4;
+    path = filename;
+    imageWidth = width;
+    imageHeight = height;
+    imageChannels = channels;
+    this->topDown = topDown;
+    next = 0;
+    rowSize = ((static_cast<uint64_t>(width) * channels + 3) / 4) * 4;
 
-    int imageSize = rowSize * height;
-    int colorTableSize = (channels == 1) ? 1024 : 0;
+    uint64_t imageSize = rowSize * height;
+    uint32_t colorTableSize = (channels == 1) ? 1024 : 0;
+    uint64_t fileSize = sizeof(BMPHeader) + colorTableSize + imageSize;
+    pixelOffset = sizeof(BMPHeader) + colorTableSize;
 
+    // The 32-bit size fields may be 0 for uncompressed data, which is what files
+    // past 4 GB have to use
     BMPHeader header{};
     header.bfType = 0x4D42;
-    header.bfSize = sizeof(BMPHeader) + colorTableSize + imageSize;
-    header.bfOffBits = sizeof(BMPHeader) + colorTableSize;
+    header.bfSize = fileSize <= UINT32_MAX ? static_cast<uint32_t>(fileSize) : 0;
+    header.bfOffBits = static_cast<uint32_t>(pixelOffset);
     header.biSize = 40;
     header.biWidth = width;
-    header.biHeight = height;
+    header.biHeight = topDown ? -height : height;
     header.biPlanes = 1;
     header.biBitCount = (channels == 1) ? 8 : 24;
     header.biCompression = 0;
-    header.biSizeImage = imageSize;
+    header.biSizeImage = imageSize <= UINT32_MAX ? static_cast<uint32_t>(imageSize) : 0;
     header.biXPelsPerMeter = 2835;
     header.biYPelsPerMeter = 2835;
 
@@ -138,27 +473,122 @@ bool Image::saveBMP(const std::string& filename) const {
             file.write(reinterpret_cast<char*>(gray), 4);
         }
     }
+    return static_cast<bool>(file);
+}
 
-    // Write pixel data (bottom-up)
-    std::vector<uint8_t> row(rowSize);
-    for (int y = height - 1; y >= 0; --y) {
-        if (channels == 1) {
-            for (int x = 0; x < width; ++x) {
-                row[x] = data[y * width + x];
-            }
-        } else { // RGB
-            for (int x = 0; x < width; ++x) {
-                int src = (y * width + x) * 3;
-                row[x * 3 + 0] = data[src + 2]; // B
-                row[x * 3 + 1] = data[src + 1]; // G
-                row[x * 3 + 2] = data[src + 0]; // R
-            }
+bool BMPStripWriter::writeRows(const unsigned char* pixels, int rows) {
+    if (!file.is_open() || rows < 0 || next + rows > imageHeight) {
+        std::cerr << "BMPStripWriter: " << rows << " rows do not fit below row " << next << "\n";
+        return false;
+    }
+
+    size_t rowLen = static_cast<size_t>(imageWidth) * imageChannels;
+    staging.assign(rowSize * std::min(kStripIOBlockRows, rows), 0);
+    IIPT_PROFILE_ALLOC(staging.size());
+    for (int b0 = 0; b0 < rows; b0 += kStripIOBlockRows) {
+        int count = std::min(kStripIOBlockRows, rows - b0);
+        for (int i = 0; i < count; ++i) {
+            // Bottom-up files store the block's rows in reverse order
+            unsigned char* dst = &staging[rowSize * (topDown ? i : count - 1 - i)];
+            const unsigned char* src = pixels + rowLen * (b0 + i);
+            if (imageChannels == 3)
+                swapRedBlue(src, dst, imageWidth);
+            else
+                std::memcpy(dst, src, rowLen);
         }
-        file.write(reinterpret_cast<char*>(row.data()), rowSize);
+
+        int y0 = next + b0;
+        uint64_t firstFileRow = topDown ? y0 : imageHeight - y0 - count;
+        file.seekp(static_cast<std::streamoff>(pixelOffset + firstFileRow * rowSize));
+        file.write(reinterpret_cast<const char*>(staging.data()), static_cast<std::streamsize>(rowSize * count));
+    }
+    next += rows;
+    return static_cast<bool>(file);
+}
+
+bool BMPStripWriter::writeStrip(const Image& strip) {
+    if (strip.width != imageWidth || strip.channels != imageChannels) {
+        std::cerr << "BMPStripWriter: strip is " << strip.width << "x" << strip.channels
+                  << ", expected " << imageWidth << "x" << imageChannels << "\n";
+        return false;
     }
+    return writeRows(strip.data.data(), strip.height);
+}
 
+bool BMPStripWriter::close() {
+    bool ok = static_cast<bool>(file) && next == imageHeight;
+    if (next != imageHeight)
+        std::cerr << "BMPStripWriter: only " << next << " of " << imageHeight << " rows written\n";
     file.close();
-    return true;
+    staging.clear();
+    staging.shrink_to_fit();
+    return ok && !file.fail();
+}
+
+void BMPStripWriter::discard() {
+    if (file.is_open()) file.close();
+    staging.clear();
+    staging.shrink_to_fit();
+    if (!path.empty()) std::remove(path.c_str());
+    path.clear();
+}
+
+bool processBMPStrips(const std::string& input, const std::string& output, int stripRows, int halo,
+                      const std::function<void(Image&)>& op) {
+    BMPStripReader reader;
+    if (!reader.open(input)) return false;
+
+    stripRows = std::max(stripRows, 1);
+    halo = std::max(halo, 0);
+    // Rows go to a temporary file that replaces output only once complete, so output may
+    // be the file being read
+    std::string partial = output + ".tmp";
+    BMPStripWriter writer;
+    int channels = 0;
+    auto run = [&]() {
+        Image strip;
+        for (int y0 = 0; y0 < reader.height(); y0 += stripRows) {
+            int y1 = std::min(y0 + stripRows, reader.height());
+            int top = std::max(0, y0 - halo);
+            int bottom = std::min(reader.height(), y1 + halo);
+            if (!reader.readRows(top, bottom, strip)) return false;
+
+            op(strip);
+            // The first strip fixes the output channel count, so point operations that
+            // change it (grayscale) stream like any other
+            if (y0 == 0) {
+                channels = strip.channels;
+                if (!writer.open(partial, reader.width(), reader.height(), channels)) return false;
+            }
+            if (strip.width != reader.width() || strip.height != bottom - top || strip.channels != channels) {
+                std::cerr << "processBMPStrips: the operation must keep the strip size and give every strip "
+                             "the same channel count\n";
+                return false;
+            }
+            size_t rowLen = static_cast<size_t>(strip.width) * strip.channels;
+            if (!writer.writeRows(&strip.data[rowLen * (y0 - top)], y1 - y0)) return false;
+        }
+        if (!writer.close()) return false;
+
+        reader.close();
+        std::error_code ec;
+        std::filesystem::rename(partial, output, ec);
+        if (ec) {
+            std::cerr << "Failed to save BMP file: " << output << " (" << ec.message() << ")\n";
+            return false;
+        }
+        return true;
+    };
+
+    bool ok = false;
+    try {
+        ok = run();
+    } catch (...) {
+        writer.discard();
+        throw;
+    }
+    if (!ok) writer.discard();
+    return ok;
 }
 
 
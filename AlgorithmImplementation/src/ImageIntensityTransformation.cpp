@@ -1,31 +1,193 @@
 #include "ImageIntensityTransformation.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
 #include <cmath>
 #include <algorithm>
 #include <iostream>
+#include <vector>
+#include <cstdint>
 
 namespace iipt {
 
+// Every point operation is evaluated once per possible input value and applied as a
+// lookup table, instead of calling std::log / std::pow for every byte.
+
 void ImageIntensityTransformation::applyNegative(Image& img) {
-    for (auto& pixel : img.data) {
-        pixel = 255 - pixel;
-    }
+    IIPT_PROFILE_SCOPE("ImageIntensityTransformation::applyNegative");
+    negativeTable().apply(img);
 }
 
 void ImageIntensityTransformation::applyLog(Image& img, float c) {
-    for (auto& pixel : img.data) {
-        pixel = static_cast<unsigned char>(
-            std::clamp(c * std::log(1.0f + static_cast<float>(pixel)), 0.0f, 255.0f)
+    IIPT_PROFILE_SCOPE("ImageIntensityTransformation::applyLog");
+    logTable(c).apply(img);
+}
+
+void ImageIntensityTransformation::applyGamma(Image& img, float gamma, float c) {
+    IIPT_PROFILE_SCOPE("ImageIntensityTransformation::applyGamma");
+    gammaTable(gamma, c).apply(img);
+}
+
+void ImageIntensityTransformation::applyLookupTable(Image& img, const LookupTable& table) {
+    IIPT_PROFILE_SCOPE("ImageIntensityTransformation::applyLookupTable");
+    table.apply(img);
+}
+
+LookupTable ImageIntensityTransformation::negativeTable() {
+    LookupTable table;
+    for (int v = 0; v < 256; ++v)
+        table[v] = static_cast<unsigned char>(255 - v);
+    return table;
+}
+
+LookupTable ImageIntensityTransformation::logTable(float c) {
+    LookupTable table;
+    for (int v = 0; v < 256; ++v) {
+        table[v] = static_cast<unsigned char>(
+            std::clamp(c * std::log(1.0f + static_cast<float>(v)), 0.0f, 255.0f)
         );
     }
+    return table;
 }
 
-void ImageIntensityTransformation::applyGamma(Image& img, float gamma, float c) {
+LookupTable ImageIntensityTransformation::gammaTable(float gamma, float c) {
+    LookupTable table;
     float invGamma = 1.0f / gamma;
-    for (auto& pixel : img.data) {
-        float normalized = static_cast<float>(pixel) / 255.0f;
+    for (int v = 0; v < 256; ++v) {
+        float normalized = static_cast<float>(v) / 255.0f;
         float transformed = c * std::pow(normalized, invGamma) * 255.0f;
-        pixel = static_cast<unsigned char>(std::clamp(transformed, 0.0f, 255.0f));
+        table[v] = static_cast<unsigned char>(std::clamp(transformed, 0.0f, 255.0f));
+    }
+    return table;
+}
+
+// ---------------------------- CLAHE ----------------------------------
+
+namespace {
+// Clip a tile histogram at `limit` and hand the excess back evenly to all bins.
+void clipHistogram(uint32_t hist[256], uint32_t limit) {
+    uint32_t excess = 0;
+    for (int v = 0; v < 256; ++v) {
+        if (hist[v] > limit) {
+            excess += hist[v] - limit;
+            hist[v] = limit;
+        }
+    }
+
+    uint32_t perBin = excess / 256;
+    uint32_t remainder = excess % 256;
+    for (int v = 0; v < 256; ++v)
+        hist[v] += perBin;
+    // Spread what is left over at regular steps so no range of values is favoured.
+    if (remainder > 0) {
+        uint32_t step = 256 / remainder;
+        for (uint32_t v = 0; v < 256 && remainder > 0; v += step, --remainder)
+            ++hist[v];
     }
 }
 
+// Bilinear weights along one axis: for each coordinate, the two neighbouring tile
+// centres and the 8-bit fixed-point weight (0..256) of the second one.
+struct AxisWeights {
+    std::vector<int> first, second, weight;
+};
+
+AxisWeights tileWeights(int size, int tiles, int tileSize) {
+    AxisWeights w;
+    w.first.resize(size);
+    w.second.resize(size);
+    w.weight.resize(size);
+    for (int i = 0; i < size; ++i) {
+        float pos = (i + 0.5f) / tileSize - 0.5f; // position in tile-centre units
+        int t0 = static_cast<int>(std::floor(pos));
+        float f = pos - t0;
+        if (t0 < 0) { t0 = 0; f = 0.0f; }
+        if (t0 >= tiles - 1) { t0 = tiles - 1; f = 0.0f; }
+        w.first[i] = t0;
+        w.second[i] = std::min(t0 + 1, tiles - 1);
+        w.weight[i] = static_cast<int>(std::lround(f * 256.0f));
+    }
+    return w;
+}
+} // anonymous namespace
+
+void ImageIntensityTransformation::applyCLAHE(Image& img, float clipLimit, int tilesX, int tilesY) {
+    IIPT_PROFILE_SCOPE("ImageIntensityTransformation::applyCLAHE");
+    if (img.width <= 0 || img.height <= 0) return;
+
+    tilesX = std::clamp(tilesX, 1, img.width);
+    tilesY = std::clamp(tilesY, 1, img.height);
+    int tileW = (img.width + tilesX - 1) / tilesX;
+    int tileH = (img.height + tilesY - 1) / tilesY;
+    // Rounding the tile size up can leave trailing tiles empty; drop them.
+    tilesX = (img.width + tileW - 1) / tileW;
+    tilesY = (img.height + tileH - 1) / tileH;
+
+    int width = img.width, channels = img.channels;
+    int tileCount = tilesX * tilesY;
+
+    // One equalization LUT per (tile, channel), built in parallel.
+    std::vector<unsigned char> luts(static_cast<size_t>(tileCount) * channels * 256);
+    IIPT_PROFILE_ALLOC(luts.size());
+    ThreadPool::parallelFor(0, tileCount * channels, [&](int first, int last) {
+        for (int job = first; job < last; ++job) {
+            int tile = job / channels, c = job % channels;
+            int x0 = (tile % tilesX) * tileW, x1 = std::min(width, x0 + tileW);
+            int y0 = (tile / tilesX) * tileH, y1 = std::min(img.height, y0 + tileH);
+
+            uint32_t hist[256] = {0};
+            for (int y = y0; y < y1; ++y) {
+                const unsigned char* row = &img.data[(static_cast<size_t>(y) * width) * channels + c];
+                for (int x = x0; x < x1; ++x)
+                    ++hist[row[x * channels]];
+            }
+
+            uint32_t area = static_cast<uint32_t>((x1 - x0) * (y1 - y0));
+            if (clipLimit > 0.0f) {
+                uint32_t limit = std::max<uint32_t>(1, static_cast<uint32_t>(clipLimit * area / 256.0f));
+                clipHistogram(hist, limit);
+            }
+
+            unsigned char* lut = &luts[static_cast<size_t>(job) * 256];
+            uint64_t cdf = 0;
+            for (int v = 0; v < 256; ++v) {
+                cdf += hist[v];
+                lut[v] = static_cast<unsigned char>(std::min<uint64_t>(255, (cdf * 255 + area / 2) / area));
+            }
+        }
+    });
+
+    AxisWeights wx = tileWeights(width, tilesX, tileW);
+    AxisWeights wy = tileWeights(img.height, tilesY, tileH);
+
+    // LUT offsets of each column's two tiles, so the inner loop is four loads and integer math.
+    size_t lutStride = static_cast<size_t>(channels) * 256;
+    std::vector<size_t> colOffset0(width), colOffset1(width);
+    for (int x = 0; x < width; ++x) {
+        colOffset0[x] = wx.first[x] * lutStride;
+        colOffset1[x] = wx.second[x] * lutStride;
+    }
+
+    ThreadPool::parallelFor(0, img.height, [&](int bandBegin, int bandEnd) {
+        for (int y = bandBegin; y < bandEnd; ++y) {
+            int fy = wy.weight[y];
+            unsigned char* row = &img.data[static_cast<size_t>(y) * width * channels];
+
+            for (int c = 0; c < channels; ++c) {
+                const unsigned char* lutTop    = &luts[wy.first[y] * tilesX * lutStride + c * 256];
+                const unsigned char* lutBottom = &luts[wy.second[y] * tilesX * lutStride + c * 256];
+
+                for (int x = 0; x < width; ++x) {
+                    unsigned char v = row[x * channels + c];
+                    int fx = wx.weight[x];
+                    int tl = lutTop[colOffset0[x] + v],    tr = lutTop[colOffset1[x] + v];
+                    int bl = lutBottom[colOffset0[x] + v], br = lutBottom[colOffset1[x] + v];
+                    int top    = tl * 256 + (tr - tl) * fx;  // 8.8 fixed point
+                    int bottom = bl * 256 + (br - bl) * fx;
+                    row[x * channels + c] = static_cast<unsigned char>((top * 256 + (bottom - top) * fy + 32768) >> 16);
+                }
+            }
+        }
+    }, 8);
+}
+
 } // namespace iipt
@@ -0,0 +1,54 @@
+#include "ImageLookupTable.h"
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace iipt {
+
+namespace {
+// Samples per parallel chunk; below this a second thread costs more than it saves.
+constexpr int kMinChunk = 1 << 18;
+} // anonymous namespace
+
+LookupTable::LookupTable() {
+    for (int v = 0; v < 256; ++v)
+        table[v] = static_cast<unsigned char>(v);
+}
+
+LookupTable LookupTable::then(const LookupTable& next) const {
+    LookupTable combined;
+    for (int v = 0; v < 256; ++v)
+        combined.table[v] = next.table[table[v]];
+    return combined;
+}
+
+void LookupTable::apply(Image& img) const {
+    apply(img.data.data(), img.data.size());
+}
+
+void LookupTable::apply(unsigned char* data, size_t count) const {
+    const unsigned char* lut = table.data();
+    auto run = [&](size_t begin, size_t end) {
+        size_t i = begin;
+        // Four independent lookups per iteration keep the load ports busy.
+        for (; i + 4 <= end; i += 4) {
+            unsigned char a = lut[data[i]];
+            unsigned char b = lut[data[i + 1]];
+            unsigned char c = lut[data[i + 2]];
+            unsigned char d = lut[data[i + 3]];
+            data[i] = a;
+            data[i + 1] = b;
+            data[i + 2] = c;
+            data[i + 3] = d;
+        }
+        for (; i < end; ++i)
+            data[i] = lut[data[i]];
+    };
+
+    // Split into chunks by an int index; chunk boundaries are in units of kMinChunk samples.
+    size_t chunks = (count + kMinChunk - 1) / kMinChunk;
+    ThreadPool::parallelFor(0, static_cast<int>(chunks), [&](int first, int last) {
+        run(static_cast<size_t>(first) * kMinChunk, std::min(count, static_cast<size_t>(last) * kMinChunk));
+    });
+}
+
+} // namespace iipt
@@ -1,149 +1,694 @@
 #include "ImageMorphology.h"
+#include "Profiler.h"
 #include "ImageUtils.h"
+#include "ThreadPool.h"
 #include <vector>
 #include <algorithm>
 #include <iostream>
 #include <cstring>
+#include <functional>
 
 namespace iipt {
 
 namespace {
-// Helper function to check SE match for erosion
-bool fits(const std::vector<unsigned char>& data, int width, int height,
-          int x, int y, const std::vector<std::vector<int>>& se) {
-    int kH = se.size();
-    int kW = se[0].size();
-    int kCX = kW / 2;
-    int kCY = kH / 2;
-
-    for (int dy = 0; dy < kH; ++dy) {
-        for (int dx = 0; dx < kW; ++dx) {
-            if (se[dy][dx] == 1) {
-                int ix = x + dx - kCX;
-                int iy = y + dy - kCY;
-                if (ix < 0 || iy < 0 || ix >= width || iy >= height ||
-                    data[iy * width + ix] == 0) {
-                    return false;
+enum class BinaryOp { Erode, Dilate };
+
+using Rect = StructuringElement::Rect;
+
+// 64 bits of a bit row starting at bit `offset`.
+inline uint64_t extractWord(const uint64_t* row, int offset) {
+    int w = offset >> 6, s = offset & 63;
+    return s ? (row[w] >> s) | (row[w + 1] << (64 - s)) : row[w];
+}
+
+struct MinOp {
+    static constexpr unsigned char identity = 255;
+    template <typename T> static T apply(T a, T b) { return std::min(a, b); }
+};
+struct MaxOp {
+    static constexpr unsigned char identity = 0;
+    template <typename T> static T apply(T a, T b) { return std::max(a, b); }
+};
+struct AndOp { static uint64_t apply(uint64_t a, uint64_t b) { return a & b; } };
+struct OrOp  { static uint64_t apply(uint64_t a, uint64_t b) { return a | b; } };
+
+// van Herk / Gil-Werman running extreme over a window of k elements:
+// out(x) = Op(in(x), ..., in(x + k - 1)) for x in [0, count), where in() is defined on
+// [0, count + k - 1). The input is cut into blocks of k; the suffix extreme of block j
+// and the prefix extreme of block j + 1 give every window starting in block j with one
+// more Op, so each element costs about 3 Ops independent of k.
+// An element is a run of elemLen values (one pixel for horizontal passes, one row for
+// vertical passes), combined value by value. `suffix` must hold k * elemLen values and
+// `prefix` elemLen values.
+template <typename Op, typename T, typename In, typename Out>
+void runningExtreme(int count, int k, int elemLen, In in, Out out, T* suffix, T* prefix) {
+    for (int s = 0; s < count; s += k) {
+        // Suffix extremes of block [s, s + k)
+        std::memcpy(suffix + static_cast<size_t>(k - 1) * elemLen, in(s + k - 1), elemLen * sizeof(T));
+        for (int t = k - 2; t >= 0; --t) {
+            const T* a = in(s + t);
+            const T* b = suffix + static_cast<size_t>(t + 1) * elemLen;
+            T* d = suffix + static_cast<size_t>(t) * elemLen;
+            for (int i = 0; i < elemLen; ++i) d[i] = Op::apply(a[i], b[i]);
+        }
+        std::memcpy(out(s), suffix, elemLen * sizeof(T));
+
+        // Prefix extremes of block [s + k, s + 2k) close the remaining windows
+        for (int t = 0; t < k - 1 && s + t + 1 < count; ++t) {
+            const T* a = in(s + k + t);
+            if (t == 0) std::memcpy(prefix, a, elemLen * sizeof(T));
+            else for (int i = 0; i < elemLen; ++i) prefix[i] = Op::apply(prefix[i], a[i]);
+
+            const T* b = suffix + static_cast<size_t>(t + 1) * elemLen;
+            T* d = out(s + t + 1);
+            for (int i = 0; i < elemLen; ++i) d[i] = Op::apply(b[i], prefix[i]);
+        }
+    }
+}
+
+// Plan selection. Estimated per-pixel (grayscale) or per-word (binary) operations for
+// visiting every tap versus running the rectangle decomposition; ImageMorphology uses
+// whichever is cheaper for the SE at hand.
+int grayDirectCost(const StructuringElement& se) {
+    return static_cast<int>(se.size());
+}
+
+int grayDecomposedCost(const StructuringElement& se) {
+    int cost = 0;
+    for (const Rect& r : se.rectangles())
+        cost += (r.width() > 1 ? 3 : 0) + (r.height() > 1 ? 3 : 0) + 2; // two passes, copy / combine
+    return cost;
+}
+
+// SE rows with the same set of active columns are combined first (AND for erosion,
+// OR for dilation) and shifted once per column afterwards. A k x k square is then
+// k row operations plus k shifts per output word instead of k^2 shifts.
+struct RowGroup {
+    std::vector<int> dys; // SE row offsets
+    std::vector<int> dxs; // active column offsets
+};
+
+std::vector<RowGroup> groupRows(const StructuringElement& se) {
+    std::vector<RowGroup> groups;
+    const auto& runs = se.runs();
+    for (size_t i = 0; i < runs.size();) {
+        int dy = runs[i].dy;
+        std::vector<int> dxs;
+        for (; i < runs.size() && runs[i].dy == dy; ++i)
+            for (int dx = runs[i].dx0; dx <= runs[i].dx1; ++dx) dxs.push_back(dx);
+
+        auto it = std::find_if(groups.begin(), groups.end(), [&](const RowGroup& g) { return g.dxs == dxs; });
+        if (it == groups.end()) groups.push_back({{dy}, dxs});
+        else it->dys.push_back(dy);
+    }
+    return groups;
+}
+
+int binaryDirectCost(const std::vector<RowGroup>& groups) {
+    int cost = 0;
+    for (const RowGroup& g : groups)
+        cost += (g.dys.size() > 1 ? static_cast<int>(g.dys.size()) : 0) + static_cast<int>(g.dxs.size());
+    return cost;
+}
+
+int binaryDecomposedCost(const StructuringElement& se) {
+    int cost = 0;
+    for (const Rect& r : se.rectangles()) {
+        int doublings = 0;
+        for (int len = 1; len < r.width(); len *= 2) ++doublings;
+        cost += doublings + 1 + (r.height() > 1 ? 3 : 0) + 1;
+    }
+    return cost;
+}
+
+// Run body(y0, y1, scratch) over all rows in chunks of a few SE heights, chunks spread
+// across the thread pool. Chunk-local buffers live in the scratch, so memory beyond the
+// output stays O(chunk rows) per thread.
+template <typename Scratch, typename Body>
+void forEachChunk(int height, const StructuringElement& se, Body body) {
+    int chunkRows = std::max(64, 4 * se.height());
+    ThreadPool::parallelFor(0, height, [&](int bandBegin, int bandEnd) {
+        Scratch scratch;
+        for (int y0 = bandBegin; y0 < bandEnd; y0 += chunkRows)
+            body(y0, std::min(y0 + chunkRows, bandEnd), scratch);
+    }, chunkRows);
+}
+
+// Which padded lines of a chunk of `count` output rows the per-tap scan reads. Line v
+// holds source row y0 + v - centerY and is read by SE row r for output row v - r, so
+// only lines within `count` of a row with active taps are needed. Lines read by no tap
+// are skipped: they may lie outside the intermediate rows a composition computes.
+std::vector<char> linesRead(const StructuringElement& se, int count) {
+    std::vector<char> read(static_cast<size_t>(count) + se.height() - 1, 0);
+    int lastRow = -1;
+    for (const auto& run : se.runs()) {
+        int r = run.dy + se.centerY();
+        if (r == lastRow) continue;
+        std::fill(read.begin() + r, read.begin() + r + count, 1);
+        lastRow = r;
+    }
+    return read;
+}
+
+// Binary engine, bit-packed and chunked like the grayscale one below.
+
+// Packed row r (0 <= r < height) of the mask being filtered.
+using BitRowAt = std::function<const uint64_t*(int)>;
+
+struct BinaryScratch {
+    std::vector<uint64_t> ext;      // horizontally padded rows
+    std::vector<uint64_t> rows;     // horizontal run results
+    std::vector<uint64_t> combined, suffix, prefix, part;
+    std::vector<uint64_t> mid;      // intermediate rows of a composition
+    std::vector<uint64_t> result;   // packed output rows of the chunk
+};
+
+// Everything about an SE / mask pair that does not change from chunk to chunk.
+struct BinaryPlan {
+    int width, height, words;
+    int pad;        // left padding bits of an extended row (the SE's centre column)
+    int extWords;   // words per extended row
+    uint64_t lastMask;
+    bool decompose;
+    std::vector<RowGroup> groups;
+};
+
+BinaryPlan makeBinaryPlan(int width, int height, const StructuringElement& se) {
+    BinaryPlan plan;
+    plan.width = width;
+    plan.height = height;
+    plan.words = (width + 63) / 64;
+    plan.pad = se.centerX();
+    plan.extWords = plan.words + (se.width() + 63) / 64 + 1;
+    plan.lastMask = (width & 63) ? ((uint64_t(1) << (width & 63)) - 1) : ~uint64_t(0);
+    plan.groups = groupRows(se);
+    plan.decompose = !se.empty() && binaryDecomposedCost(se) < binaryDirectCost(plan.groups);
+    return plan;
+}
+
+// Extended copy of source row `virtualRow` (which may lie outside the mask): ext bit
+// (pad + x) is pixel x, the pad bits on both sides follow the padding rule and rows that
+// read as background are all zero. `ext` holds at least plan.extWords words.
+void extendRow(const BitRowAt& rowAt, const BinaryPlan& plan, ImageUtils::PaddingType padding,
+               int virtualRow, uint64_t* ext) {
+    std::fill(ext, ext + plan.extWords, 0);
+    int sy = ImageUtils::borderIndex(virtualRow, plan.height, padding);
+    if (sy < 0) return;
+
+    const uint64_t* src = rowAt(sy);
+    int shift = plan.pad & 63, base = plan.pad >> 6;
+    for (int j = 0; j < plan.words; ++j) {
+        ext[base + j] |= src[j] << shift;
+        if (shift) ext[base + j + 1] |= src[j] >> (64 - shift);
+    }
+
+    auto setFrom = [&](int extBit, int x) {
+        int m = ImageUtils::borderIndex(x, plan.width, padding);
+        if (m >= 0 && ((src[m >> 6] >> (m & 63)) & 1u))
+            ext[extBit >> 6] |= uint64_t(1) << (extBit & 63);
+    };
+    for (int p = 0; p < plan.pad; ++p) {
+        setFrom(p, p - plan.pad);                                 // left border
+        setFrom(plan.pad + plan.width + p, plan.width + p);       // right border
+    }
+}
+
+// Rows [y0, y1) of the binary erosion / dilation of the mask behind rowAt, written to
+// `out` (plan.words per row). Output pixel (x, y) is the AND (erosion) or OR (dilation)
+// of the input at (x + dx, y + dy) over the SE offsets, with out-of-range taps resolved
+// by the padding rule; the same offsets ImageMorphology has always used for both.
+void binaryRows(const BitRowAt& rowAt, const BinaryPlan& plan, const StructuringElement& se,
+                ImageUtils::PaddingType padding, bool erode, int y0, int y1, uint64_t* out, BinaryScratch& s) {
+    int count = y1 - y0;
+    int words = plan.words, extWords = plan.extWords;
+    if (count <= 0) return;
+
+    if (!plan.decompose) {
+        // Row groups: combine the rows of a group, then one shift per active column
+        int lineCount = count + se.height() - 1;
+        s.ext.resize(static_cast<size_t>(lineCount) * extWords);
+        std::vector<char> read = linesRead(se, count);
+        for (int v = 0; v < lineCount; ++v)
+            if (read[v])
+                extendRow(rowAt, plan, padding, y0 + v - se.centerY(), &s.ext[static_cast<size_t>(v) * extWords]);
+
+        uint64_t identity = erode ? ~uint64_t(0) : 0;
+        s.combined.resize(extWords);
+        for (int y = 0; y < count; ++y) {
+            uint64_t* dst = out + static_cast<size_t>(y) * words;
+            std::fill(dst, dst + words, identity);
+
+            for (const RowGroup& group : plan.groups) {
+                auto extRow = [&](int dy) { return &s.ext[static_cast<size_t>(y + dy + se.centerY()) * extWords]; };
+                const uint64_t* rowBits = extRow(group.dys[0]);
+                if (group.dys.size() > 1) {
+                    std::copy_n(rowBits, extWords, s.combined.begin());
+                    for (size_t r = 1; r < group.dys.size(); ++r) {
+                        const uint64_t* srcRow = extRow(group.dys[r]);
+                        if (erode) for (int i = 0; i < extWords; ++i) s.combined[i] &= srcRow[i];
+                        else       for (int i = 0; i < extWords; ++i) s.combined[i] |= srcRow[i];
+                    }
+                    rowBits = s.combined.data();
+                }
+
+                for (int dx : group.dxs) {
+                    if (erode) for (int i = 0; i < words; ++i) dst[i] &= extractWord(rowBits, i * 64 + plan.pad + dx);
+                    else       for (int i = 0; i < words; ++i) dst[i] |= extractWord(rowBits, i * 64 + plan.pad + dx);
                 }
             }
+            dst[words - 1] &= plan.lastMask;
         }
+        return;
     }
-    return true;
-}
-
-// Helper function to check SE match for dilation
-bool hits(const std::vector<unsigned char>& data, int width, int height,
-          int x, int y, const std::vector<std::vector<int>>& se) {
-    int kH = se.size();
-    int kW = se[0].size();
-    int kCX = kW / 2;
-    int kCY = kH / 2;
-
-    for (int dy = 0; dy < kH; ++dy) {
-        for (int dx = 0; dx < kW; ++dx) {
-            if (se[dy][dx] == 1) {
-                int ix = x + dx - kCX;
-                int iy = y + dy - kCY;
-                if (ix >= 0 && iy >= 0 && ix < width && iy < height &&
-                    data[iy * width + ix] > 0) {
-                    return true;
-                }
+
+    // Union of rectangles. The horizontal run is built by doubling (log2(k) shifted
+    // ANDs / ORs per word, 64 pixels at a time); the vertical run uses runningExtreme
+    // with whole word rows as elements.
+    const auto& rects = se.rectangles();
+    for (size_t r = 0; r < rects.size(); ++r) {
+        const Rect& rect = rects[r];
+        int runWidth = rect.width(), runHeight = rect.height();
+        int rowCount = count + runHeight - 1;
+        s.ext.assign(extWords + runWidth / 64 + 2, 0);
+        s.rows.resize(static_cast<size_t>(rowCount) * words);
+        s.suffix.resize(static_cast<size_t>(runHeight) * words);
+        s.prefix.resize(words);
+
+        for (int v = 0; v < rowCount; ++v) {
+            uint64_t* run = s.ext.data();
+            extendRow(rowAt, plan, padding, y0 + v + rect.dy0, run);
+
+            // run bit p covers ext bits [p, p + len); in place, since word i only reads words >= i
+            for (int len = 1; len < runWidth;) {
+                int step = std::min(len, runWidth - len);
+                if (erode) for (int i = 0; i < extWords; ++i) run[i] &= extractWord(run, i * 64 + step);
+                else       for (int i = 0; i < extWords; ++i) run[i] |= extractWord(run, i * 64 + step);
+                len += step;
             }
+
+            uint64_t* dst = &s.rows[static_cast<size_t>(v) * words];
+            for (int i = 0; i < words; ++i) dst[i] = extractWord(run, i * 64 + plan.pad + rect.dx0);
+            dst[words - 1] &= plan.lastMask;
+        }
+
+        uint64_t* target = out;
+        if (r > 0) {
+            s.part.resize(static_cast<size_t>(count) * words);
+            target = s.part.data();
+        }
+        auto in = [&](int i) -> const uint64_t* { return &s.rows[static_cast<size_t>(i) * words]; };
+        auto dst = [&](int i) { return target + static_cast<size_t>(i) * words; };
+        if (erode) runningExtreme<AndOp>(count, runHeight, words, in, dst, s.suffix.data(), s.prefix.data());
+        else       runningExtreme<OrOp>(count, runHeight, words, in, dst, s.suffix.data(), s.prefix.data());
+
+        if (r > 0) {
+            size_t n = static_cast<size_t>(count) * words;
+            if (erode) for (size_t i = 0; i < n; ++i) out[i] &= s.part[i];
+            else       for (size_t i = 0; i < n; ++i) out[i] |= s.part[i];
         }
     }
-    return false;
 }
-} // anonymous namespace
 
-void ImageMorphology::erosion(Image& img, const std::vector<std::vector<int>>& se, ImageUtils::PaddingType padding) {
-    if (img.channels != 1) {
-        std::cerr << "Erosion only supports grayscale/binary images.\n";
-        return;
+// Rows [y0, y1) of the second operation applied to the result of the first (opening:
+// erode then dilate, closing: the reverse). Only the intermediate rows the second stage
+// reads are computed, into s.mid.
+void composedBinaryRows(const BitRowAt& rowAt, const BinaryPlan& plan, const StructuringElement& se,
+                        ImageUtils::PaddingType padding, bool erodeFirst, int y0, int y1, uint64_t* out,
+                        BinaryScratch& s) {
+    int lo = plan.height, hi = -1;
+    for (const auto& run : se.runs()) {
+        for (int y = y0; y < y1; ++y) {
+            int sy = ImageUtils::borderIndex(y + run.dy, plan.height, padding);
+            if (sy >= 0) { lo = std::min(lo, sy); hi = std::max(hi, sy); }
+        }
     }
 
-    int kH = se.size();
-    int kW = se[0].size();
-    int padY = kH / 2;
-    int padX = kW / 2;
+    if (hi >= lo) {
+        s.mid.resize(static_cast<size_t>(hi - lo + 1) * plan.words);
+        binaryRows(rowAt, plan, se, padding, erodeFirst, lo, hi + 1, s.mid.data(), s);
+    }
+    BitRowAt midAt = [&](int r) { return &s.mid[static_cast<size_t>(r - lo) * plan.words]; };
+    binaryRows(midAt, plan, se, padding, !erodeFirst, y0, y1, out, s);
+}
 
-    std::vector<unsigned char> padded = ImageUtils::padImage(img.data, img.width, img.height, 1, padX, padY, padding);
-    int paddedWidth = img.width + 2 * padX;
-    int paddedHeight = img.height + 2 * padY;
+BinaryImage binaryMorphology(const BinaryImage& src, const StructuringElement& se,
+                             ImageUtils::PaddingType padding, BinaryOp op) {
+    if (se.empty()) {
+        std::cerr << "Morphology needs a structuring element with at least one tap.\n";
+        return src;
+    }
+    BinaryImage out(src.width, src.height);
+    if (src.width == 0 || src.height == 0) return out;
 
-    std::vector<unsigned char> output(img.width * img.height, 0);
+    BinaryPlan plan = makeBinaryPlan(src.width, src.height, se);
+    BitRowAt rowAt = [&](int r) { return src.row(r); };
+    forEachChunk<BinaryScratch>(src.height, se, [&](int y0, int y1, BinaryScratch& s) {
+        binaryRows(rowAt, plan, se, padding, op == BinaryOp::Erode, y0, y1, out.row(y0), s);
+    });
+    return out;
+}
 
-    for (int y = 0; y < img.height; ++y) {
-        for (int x = 0; x < img.width; ++x) {
-            if (fits(padded, paddedWidth, paddedHeight, x + padX, y + padY, se))
-                output[y * img.width + x] = 255;
-        }
+enum class BinaryComposite { Erosion, Dilation, Opening, Closing, Boundary };
+
+// The 8-bit binary operations. Any non-zero sample is foreground. The input is packed
+// once (1 bit per pixel), each chunk streams through one or two passes in chunk-local
+// rows, and the result is written straight back into img.data: no padded copy, no
+// intermediate image and no copy of the original.
+void binaryComposite(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding, BinaryComposite op) {
+    if (img.width == 0 || img.height == 0) return;
+    if (se.empty()) {
+        std::cerr << "Morphology needs a structuring element with at least one tap.\n";
+        return;
     }
 
-    img.data = std::move(output);
+    BinaryImage packed;
+    {
+        IIPT_PROFILE_PHASE("pack");
+        packed = BinaryImage::fromImage(img);
+        IIPT_PROFILE_ALLOC(packed.bits.size() * sizeof(uint64_t));
+    }
+    BinaryPlan plan = makeBinaryPlan(img.width, img.height, se);
+    BitRowAt rowAt = [&](int r) { return packed.row(r); };
+
+    IIPT_PROFILE_PHASE("binaryChunks");
+    forEachChunk<BinaryScratch>(img.height, se, [&](int y0, int y1, BinaryScratch& s) {
+        s.result.resize(static_cast<size_t>(y1 - y0) * plan.words);
+        uint64_t* result = s.result.data();
+        switch (op) {
+        case BinaryComposite::Erosion:
+        case BinaryComposite::Boundary:
+            binaryRows(rowAt, plan, se, padding, true, y0, y1, result, s);
+            break;
+        case BinaryComposite::Dilation:
+            binaryRows(rowAt, plan, se, padding, false, y0, y1, result, s);
+            break;
+        case BinaryComposite::Opening:
+            composedBinaryRows(rowAt, plan, se, padding, true, y0, y1, result, s);
+            break;
+        case BinaryComposite::Closing:
+            composedBinaryRows(rowAt, plan, se, padding, false, y0, y1, result, s);
+            break;
+        }
+
+        for (int y = y0; y < y1; ++y) {
+            const uint64_t* bits = result + static_cast<size_t>(y - y0) * plan.words;
+            unsigned char* dst = &img.data[static_cast<size_t>(y) * img.width];
+            if (op == BinaryComposite::Boundary) {
+                // original - eroded, clamped: eroded pixels become 0, the rest keep their value
+                for (int x = 0; x < img.width; ++x)
+                    if ((bits[x >> 6] >> (x & 63)) & 1u) dst[x] = 0;
+            } else {
+                for (int x = 0; x < img.width; ++x)
+                    dst[x] = ((bits[x >> 6] >> (x & 63)) & 1u) ? 255 : 0;
+            }
+        }
+    });
 }
 
-void ImageMorphology::dilation(Image& img, const std::vector<std::vector<int>>& se, ImageUtils::PaddingType padding) {
-    if (img.channels != 1) {
-        std::cerr << "Dilation only supports grayscale/binary images.\n";
+// Grayscale min / max engine. Output rows are produced in chunks: each chunk pads only
+// the source rows its taps reach, so no padded or intermediate full image is stored and
+// compositions (opening, top-hat, gradient, ...) run chunk by chunk.
+
+// Row r (0 <= r < height) of the image being filtered.
+using RowAt = std::function<const unsigned char*(int)>;
+
+struct GrayScratch {
+    std::vector<unsigned char> lines;   // padded source rows
+    std::vector<unsigned char> rows;    // horizontal pass results
+    std::vector<unsigned char> suffix, prefix, part;
+    std::vector<unsigned char> first, second; // intermediate rows of a composition
+};
+
+struct GrayGeometry {
+    int width, height, channels;
+    size_t rowLen;
+};
+
+// True if the rectangle decomposition is estimated to beat visiting every tap.
+bool useDecomposition(const StructuringElement& se) {
+    return !se.empty() && grayDecomposedCost(se) < grayDirectCost(se);
+}
+
+// Pad source row `virtualRow` (which may lie outside the image) into `line`, so that
+// line pixel i is source column i + firstColumn.
+void padRow(const RowAt& rowAt, const GrayGeometry& g, ImageUtils::PaddingType padding,
+            int virtualRow, int firstColumn, int lineLen, unsigned char* line) {
+    int sy = ImageUtils::borderIndex(virtualRow, g.height, padding);
+    if (sy < 0)
+        std::memset(line, 0, static_cast<size_t>(lineLen) * g.channels);
+    else
+        ImageUtils::padRow(rowAt(sy), g.width, g.channels, firstColumn, lineLen, padding, line);
+}
+
+// Rows [y0, y1) of the grayscale erosion (MinOp) / dilation (MaxOp) of the image behind
+// rowAt, with the same tap offsets and padding rules as the binary operations, written
+// to `out` ((y1 - y0) rows of g.rowLen).
+template <typename Op>
+void extremeRows(const RowAt& rowAt, const GrayGeometry& g, const StructuringElement& se, bool decompose,
+                 ImageUtils::PaddingType padding, int y0, int y1, unsigned char* out, GrayScratch& s) {
+    int count = y1 - y0;
+    if (count <= 0) return;
+
+    if (!decompose) {
+        // Every tap is a fixed linear offset into the padded rows of this chunk
+        int padX = se.centerX(), padY = se.centerY();
+        int lineLen = g.width + 2 * padX;
+        size_t lineStride = static_cast<size_t>(lineLen) * g.channels;
+        int lineCount = count + se.height() - 1;
+        s.lines.resize(lineStride * lineCount);
+        std::vector<char> read = linesRead(se, count);
+        for (int v = 0; v < lineCount; ++v)
+            if (read[v]) padRow(rowAt, g, padding, y0 + v - padY, -padX, lineLen, &s.lines[lineStride * v]);
+
+        std::vector<std::ptrdiff_t> taps = se.linearOffsets(lineStride, g.channels);
+        for (int y = 0; y < count; ++y) {
+            const unsigned char* center = &s.lines[lineStride * (y + padY) + static_cast<size_t>(padX) * g.channels];
+            unsigned char* dst = out + g.rowLen * y;
+            for (size_t i = 0; i < g.rowLen; ++i) {
+                unsigned char v = Op::identity;
+                for (std::ptrdiff_t offset : taps) v = Op::apply(v, center[static_cast<std::ptrdiff_t>(i) + offset]);
+                dst[i] = v;
+            }
+        }
         return;
     }
 
-    int kH = se.size();
-    int kW = se[0].size();
-    int padY = kH / 2;
-    int padX = kW / 2;
+    // Union of rectangles: a horizontal then a vertical van Herk / Gil-Werman pass each
+    const auto& rects = se.rectangles();
+    for (size_t r = 0; r < rects.size(); ++r) {
+        const Rect& rect = rects[r];
+        int runWidth = rect.width(), runHeight = rect.height();
+        int lineLen = g.width + runWidth - 1;
+        int rowCount = count + runHeight - 1;
+        s.lines.resize(static_cast<size_t>(lineLen) * g.channels);
+        s.rows.resize(g.rowLen * rowCount);
+        s.suffix.resize(std::max(static_cast<size_t>(runWidth) * g.channels, g.rowLen * runHeight));
+        s.prefix.resize(g.rowLen);
 
-    std::vector<unsigned char> padded = ImageUtils::padImage(img.data, img.width, img.height, 1, padX, padY, padding);
-    int paddedWidth = img.width + 2 * padX;
-    int paddedHeight = img.height + 2 * padY;
+        for (int v = 0; v < rowCount; ++v) {
+            padRow(rowAt, g, padding, y0 + v + rect.dy0, rect.dx0, lineLen, s.lines.data());
+            unsigned char* dst = &s.rows[g.rowLen * v];
+            runningExtreme<Op>(g.width, runWidth, g.channels,
+                               [&](int i) { return &s.lines[static_cast<size_t>(i) * g.channels]; },
+                               [&](int i) { return dst + static_cast<size_t>(i) * g.channels; },
+                               s.suffix.data(), s.prefix.data());
+        }
 
-    std::vector<unsigned char> output(img.width * img.height, 0);
+        unsigned char* target = out;
+        if (r > 0) {
+            s.part.resize(g.rowLen * count);
+            target = s.part.data();
+        }
+        runningExtreme<Op>(count, runHeight, static_cast<int>(g.rowLen),
+                           [&](int i) { return &s.rows[g.rowLen * i]; },
+                           [&](int i) { return target + g.rowLen * i; },
+                           s.suffix.data(), s.prefix.data());
+        if (r > 0)
+            for (size_t i = 0; i < g.rowLen * count; ++i) out[i] = Op::apply(out[i], s.part[i]);
+    }
+}
 
-    for (int y = 0; y < img.height; ++y) {
-        for (int x = 0; x < img.width; ++x) {
-            if (hits(padded, paddedWidth, paddedHeight, x + padX, y + padY, se))
-                output[y * img.width + x] = 255;
+// Rows [y0, y1) of Second(First(image)). Only the rows of First(image) that the second
+// stage reads (after padding) are computed, into `mid`.
+template <typename First, typename Second>
+void composedRows(const RowAt& rowAt, const GrayGeometry& g, const StructuringElement& se, bool decompose,
+                  ImageUtils::PaddingType padding, int y0, int y1, unsigned char* out,
+                  std::vector<unsigned char>& mid, GrayScratch& s) {
+    int lo = g.height, hi = -1;
+    for (const auto& run : se.runs()) {
+        for (int y = y0; y < y1; ++y) {
+            int sy = ImageUtils::borderIndex(y + run.dy, g.height, padding);
+            if (sy >= 0) { lo = std::min(lo, sy); hi = std::max(hi, sy); }
         }
     }
 
+    if (hi >= lo) {
+        mid.resize(g.rowLen * (hi - lo + 1));
+        extremeRows<First>(rowAt, g, se, decompose, padding, lo, hi + 1, mid.data(), s);
+    }
+    RowAt midAt = [&](int r) { return &mid[g.rowLen * (r - lo)]; };
+    extremeRows<Second>(midAt, g, se, decompose, padding, y0, y1, out, s);
+}
+
+template <typename Op>
+void grayMorphology(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding) {
+    if (img.width == 0 || img.height == 0) return;
+    if (se.empty()) {
+        std::cerr << "Morphology needs a structuring element with at least one tap.\n";
+        return;
+    }
+
+    GrayGeometry g{img.width, img.height, img.channels, static_cast<size_t>(img.width) * img.channels};
+    bool decompose = useDecomposition(se);
+    RowAt rowAt = [&](int r) { return &img.data[g.rowLen * r]; };
+
+    IIPT_PROFILE_PHASE("grayChunks");
+    std::vector<unsigned char> output(img.data.size());
+    IIPT_PROFILE_ALLOC(output.size());
+    forEachChunk<GrayScratch>(img.height, se, [&](int y0, int y1, GrayScratch& s) {
+        extremeRows<Op>(rowAt, g, se, decompose, padding, y0, y1, &output[g.rowLen * y0], s);
+    });
     img.data = std::move(output);
 }
 
-void ImageMorphology::opening(Image& img, const std::vector<std::vector<int>>& se, ImageUtils::PaddingType padding) {
-    std::vector<unsigned char> original = img.data;
+enum class GrayComposite { Opening, Closing, TopHat, BlackHat, Gradient };
 
-    erosion(img, se, padding);
-    dilation(img, se, padding);
+// Opening / closing and the derived transforms, fused per chunk: the intermediate
+// erosion / dilation exists only for the rows a chunk needs.
+void grayComposite(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding, GrayComposite op) {
+    if (img.width == 0 || img.height == 0) return;
+    if (se.empty()) {
+        std::cerr << "Morphology needs a structuring element with at least one tap.\n";
+        return;
+    }
 
-    if (img.data.empty())
-        img.data = std::move(original);
+    GrayGeometry g{img.width, img.height, img.channels, static_cast<size_t>(img.width) * img.channels};
+    bool decompose = useDecomposition(se);
+    RowAt rowAt = [&](int r) { return &img.data[g.rowLen * r]; };
+
+    IIPT_PROFILE_PHASE("grayChunks");
+    std::vector<unsigned char> output(img.data.size());
+    IIPT_PROFILE_ALLOC(output.size());
+    forEachChunk<GrayScratch>(img.height, se, [&](int y0, int y1, GrayScratch& s) {
+        unsigned char* dst = &output[g.rowLen * y0];
+        const unsigned char* src = &img.data[g.rowLen * y0];
+        size_t n = g.rowLen * (y1 - y0);
+
+        switch (op) {
+        case GrayComposite::Opening:
+            composedRows<MinOp, MaxOp>(rowAt, g, se, decompose, padding, y0, y1, dst, s.first, s);
+            break;
+        case GrayComposite::Closing:
+            composedRows<MaxOp, MinOp>(rowAt, g, se, decompose, padding, y0, y1, dst, s.first, s);
+            break;
+        case GrayComposite::TopHat:
+            composedRows<MinOp, MaxOp>(rowAt, g, se, decompose, padding, y0, y1, dst, s.first, s);
+            for (size_t i = 0; i < n; ++i) dst[i] = src[i] > dst[i] ? src[i] - dst[i] : 0;
+            break;
+        case GrayComposite::BlackHat:
+            composedRows<MaxOp, MinOp>(rowAt, g, se, decompose, padding, y0, y1, dst, s.first, s);
+            for (size_t i = 0; i < n; ++i) dst[i] = dst[i] > src[i] ? dst[i] - src[i] : 0;
+            break;
+        case GrayComposite::Gradient:
+            s.second.resize(n);
+            extremeRows<MaxOp>(rowAt, g, se, decompose, padding, y0, y1, dst, s);
+            extremeRows<MinOp>(rowAt, g, se, decompose, padding, y0, y1, s.second.data(), s);
+            for (size_t i = 0; i < n; ++i) dst[i] = dst[i] > s.second[i] ? dst[i] - s.second[i] : 0;
+            break;
+        }
+    });
+    img.data = std::move(output);
 }
+} // anonymous namespace
 
-void ImageMorphology::closing(Image& img, const std::vector<std::vector<int>>& se, ImageUtils::PaddingType padding) {
-    std::vector<unsigned char> original = img.data;
+void ImageMorphology::erosion(BinaryImage& img, const StructuringElement& se, ImageUtils::PaddingType padding) {
+    IIPT_PROFILE_SCOPE("ImageMorphology::erosion(binary)");
+    img = binaryMorphology(img, se, padding, BinaryOp::Erode);
+}
 
-    dilation(img, se, padding);
-    erosion(img, se, padding);
+void ImageMorphology::dilation(BinaryImage& img, const StructuringElement& se, ImageUtils::PaddingType padding) {
+    IIPT_PROFILE_SCOPE("ImageMorphology::dilation(binary)");
+    img = binaryMorphology(img, se, padding, BinaryOp::Dilate);
+}
 
-    if (img.data.empty())
-        img.data = std::move(original);
+void ImageMorphology::erosion(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding) {
+    IIPT_PROFILE_SCOPE("ImageMorphology::erosion");
+    if (img.channels != 1) {
+        std::cerr << "Erosion only supports grayscale/binary images.\n";
+        return;
+    }
+    binaryComposite(img, se, padding, BinaryComposite::Erosion);
 }
 
-void ImageMorphology::boundaryExtract(Image& img, const std::vector<std::vector<int>>& se, ImageUtils::PaddingType padding) {
+void ImageMorphology::dilation(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding) {
+    IIPT_PROFILE_SCOPE("ImageMorphology::dilation");
     if (img.channels != 1) {
-        std::cerr << "Boundary extraction only supports grayscale/binary images.\n";
+        std::cerr << "Dilation only supports grayscale/binary images.\n";
         return;
     }
+    binaryComposite(img, se, padding, BinaryComposite::Dilation);
+}
 
-    std::vector<unsigned char> original = img.data;
-    Image temp = img;
-    temp.data = original;
+void ImageMorphology::grayErosion(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding) {
+    IIPT_PROFILE_SCOPE("ImageMorphology::grayErosion");
+    grayMorphology<MinOp>(img, se, padding);
+}
 
-    erosion(temp, se, padding);
+void ImageMorphology::grayDilation(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding) {
+    IIPT_PROFILE_SCOPE("ImageMorphology::grayDilation");
+    grayMorphology<MaxOp>(img, se, padding);
+}
+
+void ImageMorphology::grayOpening(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding) {
+    IIPT_PROFILE_SCOPE("ImageMorphology::grayOpening");
+    grayComposite(img, se, padding, GrayComposite::Opening);
+}
+
+void ImageMorphology::grayClosing(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding) {
+    IIPT_PROFILE_SCOPE("ImageMorphology::grayClosing");
+    grayComposite(img, se, padding, GrayComposite::Closing);
+}
+
+void ImageMorphology::topHat(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding) {
+    IIPT_PROFILE_SCOPE("ImageMorphology::topHat");
+    grayComposite(img, se, padding, GrayComposite::TopHat);
+}
 
-    for (size_t i = 0; i < img.data.size(); ++i) {
-        img.data[i] = std::clamp<int>(original[i] - temp.data[i], 0, 255);
+void ImageMorphology::blackHat(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding) {
+    IIPT_PROFILE_SCOPE("ImageMorphology::blackHat");
+    grayComposite(img, se, padding, GrayComposite::BlackHat);
+}
+
+void ImageMorphology::morphologicalGradient(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding) {
+    IIPT_PROFILE_SCOPE("ImageMorphology::morphologicalGradient");
+    grayComposite(img, se, padding, GrayComposite::Gradient);
+}
+
+void ImageMorphology::opening(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding) {
+    IIPT_PROFILE_SCOPE("ImageMorphology::opening");
+    if (img.channels != 1) {
+        std::cerr << "Opening only supports grayscale/binary images.\n";
+        return;
+    }
+    binaryComposite(img, se, padding, BinaryComposite::Opening);
+}
+
+void ImageMorphology::closing(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding) {
+    IIPT_PROFILE_SCOPE("ImageMorphology::closing");
+    if (img.channels != 1) {
+        std::cerr << "Closing only supports grayscale/binary images.\n";
+        return;
+    }
+    binaryComposite(img, se, padding, BinaryComposite::Closing);
+}
+
+void ImageMorphology::boundaryExtract(Image& img, const StructuringElement& se, ImageUtils::PaddingType padding) {
+    IIPT_PROFILE_SCOPE("ImageMorphology::boundaryExtract");
+    if (img.channels != 1) {
+        std::cerr << "Boundary extraction only supports grayscale/binary images.\n";
+        return;
     }
+    binaryComposite(img, se, padding, BinaryComposite::Boundary);
 }
 
-} // namespace iipt
\ No newline at end of file
+} // namespace iipt
@@ -1,46 +1,108 @@
 #include "ImageSpatialTransformation.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include "ImageUtils.h"
 #include <cmath>
 #include <algorithm>
 #include <stdexcept>
 #include <iostream>
+#include <cstdint>
 
 namespace iipt {
 
+namespace {
+// The spatial filters keep their own PaddingType; the border rules are ImageUtils'.
+ImageUtils::PaddingType borderRule(SpatialTransformation::PaddingType padding) {
+    switch (padding) {
+    case SpatialTransformation::PaddingType::Zero:      return ImageUtils::PaddingType::Zero;
+    case SpatialTransformation::PaddingType::Replicate: return ImageUtils::PaddingType::Replicate;
+    case SpatialTransformation::PaddingType::Mirror:    return ImageUtils::PaddingType::Mirror;
+    case SpatialTransformation::PaddingType::None:
+    default:                                            return ImageUtils::PaddingType::None;
+    }
+}
+
+// Source coordinate for every tap position of one axis: entry (i + k) belongs to
+// position i, for i in [-k, n + k); -1 taps contribute nothing (None / Zero).
+std::vector<int> buildIndexTable(int n, int k, SpatialTransformation::PaddingType padding) {
+    IIPT_PROFILE_PHASE("padding");
+    return ImageUtils::borderTable(n, k, k, borderRule(padding));
+}
+
+// Smallest row band worth handing to another thread.
+constexpr int kMinBandRows = 8;
+// Smallest chunk of samples for element-wise combine loops.
+constexpr int kMinCombineChunk = 1 << 16;
+} // anonymous namespace
+
 // -------------------- For Users ------------------------------------------------------
 
 void SpatialTransformation::applyBoxFilter(Image& img, int kernelSize, PaddingType padding) {
+    IIPT_PROFILE_SCOPE("SpatialTransformation::applyBoxFilter");
     img.data = boxFilterCore(img.data, img.width, img.height, img.channels, kernelSize, padding);
 }
 
 void SpatialTransformation::applyGaussianFilter(Image& img, int kernelSize, float sigma, PaddingType padding) {
+    IIPT_PROFILE_SCOPE("SpatialTransformation::applyGaussianFilter");
     img.data = gaussianFilterCore(img.data, img.width, img.height, img.channels, kernelSize, padding, sigma);
 }
 
 void SpatialTransformation::applyMedianFilter(Image& img, int kernelSize, PaddingType padding) {
+    IIPT_PROFILE_SCOPE("SpatialTransformation::applyMedianFilter");
     img.data = medianFilterCore(img.data, img.width, img.height, img.channels, kernelSize, padding);
 }
 
+void SpatialTransformation::applyConvolution(Image& img, const std::vector<std::vector<float>>& kernel, PaddingType padding) {
+    IIPT_PROFILE_SCOPE("SpatialTransformation::applyConvolution");
+    img.data = convolve(img.data, img.width, img.height, img.channels, kernel, padding);
+}
+
+void SpatialTransformation::applyMinFilter(Image& img, int kernelSize, PaddingType padding) {
+    IIPT_PROFILE_SCOPE("SpatialTransformation::applyMinFilter");
+    img.data = rankFilterCore(img.data, img.width, img.height, img.channels, kernelSize, 0, padding);
+}
+
+void SpatialTransformation::applyMaxFilter(Image& img, int kernelSize, PaddingType padding) {
+    IIPT_PROFILE_SCOPE("SpatialTransformation::applyMaxFilter");
+    int window = 2 * (kernelSize / 2) + 1;
+    img.data = rankFilterCore(img.data, img.width, img.height, img.channels, kernelSize, window * window - 1, padding);
+}
+
+void SpatialTransformation::applyPercentileFilter(Image& img, int kernelSize, float percentile, PaddingType padding) {
+    IIPT_PROFILE_SCOPE("SpatialTransformation::applyPercentileFilter");
+    int window = 2 * (kernelSize / 2) + 1;
+    float p = std::clamp(percentile, 0.0f, 100.0f) / 100.0f;
+    int rank = static_cast<int>(std::lround(p * (window * window - 1)));
+    img.data = rankFilterCore(img.data, img.width, img.height, img.channels, kernelSize, rank, padding);
+}
+
 void SpatialTransformation::applyLaplacianBasic(Image& img, bool inverted, PaddingType padding) {
+    IIPT_PROFILE_SCOPE("SpatialTransformation::applyLaplacianBasic");
     img.data = laplacianBasicCore(img.data, img.width, img.height, img.channels, inverted, padding);
 }
 
 void SpatialTransformation::applyLaplacianFull(Image& img, bool inverted, PaddingType padding) {
+    IIPT_PROFILE_SCOPE("SpatialTransformation::applyLaplacianFull");
     img.data = laplacianFullCore(img.data, img.width, img.height, img.channels, inverted, padding);
 }
 
 void SpatialTransformation::applySobel(Image& img, PaddingType padding) {
+    IIPT_PROFILE_SCOPE("SpatialTransformation::applySobel");
     img.data = sobelCore(img.data, img.width, img.height, img.channels, padding);
 }
 
 void SpatialTransformation::applySharpening(Image& img, const std::string& method, PaddingType padding) {
+    IIPT_PROFILE_SCOPE("SpatialTransformation::applySharpening");
     img.data = sharpeningCore(img.data, img.width, img.height, img.channels, method, padding);
 }
 
 void SpatialTransformation::applyUnsharpMasking(Image& img, const std::string& kernelType, int kernelSize, float sigma, PaddingType padding) {
+    IIPT_PROFILE_SCOPE("SpatialTransformation::applyUnsharpMasking");
     img.data = unsharpMaskingCore(img.data, img.width, img.height, img.channels, kernelType, kernelSize, sigma, padding);
 }
 
 void SpatialTransformation::applyHighboostFiltering(Image& img, const std::string& kernelType, int kernelSize, float K, float sigma, PaddingType padding) {
+    IIPT_PROFILE_SCOPE("SpatialTransformation::applyHighboostFiltering");
     img.data = highboostFilteringCore(img.data, img.width, img.height, img.channels, kernelType, kernelSize, K, sigma, padding);
 }
 
@@ -49,67 +111,167 @@ void SpatialTransformation::applyHighboostFiltering(Image& img, const std::strin
 std::vector<unsigned char> SpatialTransformation::boxFilterCore(const std::vector<unsigned char>& input, 
                                                                 int width, int height, int channels, 
                                                                 int kernelSize, PaddingType padding) {
-    std::vector<std::vector<float>> kernel(kernelSize, std::vector<float>(kernelSize, 1.0f / (kernelSize * kernelSize)));
-    return convolve(input, width, height, channels, kernel, padding);
+    IIPT_PROFILE_PHASE("boxFilterCore");
+    // Running sums: per-column vertical sums are updated by one row in / one row out, and
+    // each output row is a horizontal sliding sum over them, so the cost per pixel does not
+    // depend on kernelSize. Sums are exact integers and the mean is floor(sum / area).
+    // convolve() truncates a float sum of pixel * (1.0f / area) instead, whose rounding
+    // can land a mean that is exactly an integer just below it, so results may differ
+    // from it by at most 1 LSB.
+    int k = kernelSize / 2;
+    int area = kernelSize * kernelSize;
+    std::vector<unsigned char> output(width * height * channels, 0);
+    IIPT_PROFILE_ALLOC(output.size());
+
+    int startY = (padding == PaddingType::None) ? k : 0;
+    int endY   = (padding == PaddingType::None) ? height - k : height;
+    int startX = (padding == PaddingType::None) ? k : 0;
+    int endX   = (padding == PaddingType::None) ? width - k : width;
+    if (kernelSize <= 0 || startX >= endX || startY >= endY) return output;
+
+    std::vector<int> colIndex = buildIndexTable(width, k, padding);
+    std::vector<int> rowIndex = buildIndexTable(height, k, padding);
+
+    int rowLen = width * channels;
+    ThreadPool::parallelFor(startY, endY, [&](int bandBegin, int bandEnd) {
+        std::vector<uint32_t> colSum(rowLen, 0);
+
+        auto addRow = [&](int tableY, int sign) {
+            int py = rowIndex[tableY];
+            if (py < 0) return; // zero padding
+            const unsigned char* src = &input[py * rowLen];
+            if (sign > 0) for (int i = 0; i < rowLen; ++i) colSum[i] += src[i];
+            else          for (int i = 0; i < rowLen; ++i) colSum[i] -= src[i];
+        };
+
+        // Window for row y covers table rows [y, y + kernelSize); each band starts from the
+        // halo rows above it, so the integer sums equal the single-threaded ones.
+        for (int j = 0; j < kernelSize; ++j)
+            addRow(bandBegin + j, +1);
+
+        for (int y = bandBegin; y < bandEnd; ++y) {
+            if (y > bandBegin) {
+                addRow(y - 1, -1);
+                addRow(y + kernelSize - 1, +1);
+            }
+
+            unsigned char* dst = &output[y * rowLen];
+            for (int c = 0; c < channels; ++c) {
+                auto column = [&](int tableX) -> uint32_t {
+                    int px = colIndex[tableX];
+                    return (px < 0) ? 0 : colSum[px * channels + c];
+                };
+
+                uint32_t sum = 0;
+                for (int i = 0; i < kernelSize; ++i)
+                    sum += column(startX + i);
+
+                for (int x = startX; x < endX; ++x) {
+                    if (x > startX)
+                        sum += column(x + kernelSize - 1) - column(x - 1);
+                    dst[x * channels + c] = static_cast<unsigned char>(sum / area);
+                }
+            }
+        }
+    }, kMinBandRows);
+
+    return output;
 }
 
 std::vector<unsigned char> SpatialTransformation::gaussianFilterCore(const std::vector<unsigned char>& input, 
                                                                     int width, int height, int channels, int kernelSize, PaddingType padding, float sigma) {
-    auto kernel = generateGaussianKernel(kernelSize, sigma);
-    return convolve(input, width, height, channels, kernel, padding);
+    auto kernel = generateGaussianKernel1D(kernelSize, sigma);
+    return convolveSeparable(input, width, height, channels, kernel, kernel, padding);
 }
 
 std::vector<unsigned char> SpatialTransformation::medianFilterCore(const std::vector<unsigned char>& input,
                                                                     int width, int height, int channels,
                                                                     int kernelSize, PaddingType padding)
 {
+    int window = 2 * (kernelSize / 2) + 1;
+    return rankFilterCore(input, width, height, channels, kernelSize, (window * window) / 2, padding);
+}
+
+std::vector<unsigned char> SpatialTransformation::rankFilterCore(const std::vector<unsigned char>& input,
+                                                                  int width, int height, int channels,
+                                                                  int kernelSize, int rank, PaddingType padding)
+{
+    IIPT_PROFILE_PHASE("rankFilterCore");
+    // Huang's sliding-window algorithm: keep a 256-bin histogram of the current window and,
+    // when moving one pixel to the right, drop the leftmost column and add the new rightmost
+    // one. A 16-bin coarse histogram on top lets the rank search finish in at most 32 steps.
+    // Out-of-range taps behave exactly like the sorting implementation: zero padding adds
+    // zeros, so every window holds (2k+1)^2 samples and the result is the rank-th smallest.
     int k = kernelSize / 2;
+    int window = 2 * k + 1;
+    rank = std::clamp(rank, 0, window * window - 1);
     std::vector<unsigned char> output(width * height * channels, 0);
+    IIPT_PROFILE_ALLOC(output.size());
 
     int startY = (padding == PaddingType::None) ? k : 0;
     int endY   = (padding == PaddingType::None) ? height - k : height;
     int startX = (padding == PaddingType::None) ? k : 0;
     int endX   = (padding == PaddingType::None) ? width - k : width;
+    if (startX >= endX || startY >= endY) return output;
+
+    std::vector<int> colIndex = buildIndexTable(width, k, padding);
+    std::vector<int> rowIndex = buildIndexTable(height, k, padding);
+    ThreadPool::parallelFor(startY, endY, [&](int bandBegin, int bandEnd) {
+        std::vector<const unsigned char*> rows;
+        rows.reserve(window);
+
+        for (int y = bandBegin; y < bandEnd; ++y) {
+            // Source rows of the vertical taps. Zero-padded rows only ever contribute zeros,
+            // so they are counted once instead of being tested on every tap.
+            rows.clear();
+            int zeroRows = 0;
+            for (int j = 0; j < window; ++j) {
+                int py = rowIndex[y + j];
+                if (py < 0) ++zeroRows;
+                else rows.push_back(&input[py * width * channels]);
+            }
 
-    for (int y = startY; y < endY; ++y) {
-        for (int x = startX; x < endX; ++x) {
             for (int c = 0; c < channels; ++c) {
-                std::vector<unsigned char> neighborhood;
-
-                for (int dy = -k; dy <= k; ++dy) {
-                    for (int dx = -k; dx <= k; ++dx) {
-                        int px = x + dx;
-                        int py = y + dy;
-
-                        if (px < 0 || px >= width || py < 0 || py >= height) {
-                            if (padding == PaddingType::None) continue;
-                            else if (padding == PaddingType::Zero) {
-                                neighborhood.push_back(0);
-                                continue;
-                            }
-                            else if (padding == PaddingType::Replicate) {
-                                px = std::clamp(px, 0, width - 1);
-                                py = std::clamp(py, 0, height - 1);
-                            }
-                            else if (padding == PaddingType::Mirror) {
-                                if (px < 0) px = -px;
-                                if (px >= width) px = 2 * width - px - 2;
-                                if (py < 0) py = -py;
-                                if (py >= height) py = 2 * height - py - 2;
-                            }
-                        }
-
-                        int idx = (py * width + px) * channels + c;
-                        neighborhood.push_back(input[idx]);
+                int fine[256] = {0};
+                int coarse[16] = {0};
+
+                auto updateColumn = [&](int tableX, int delta) {
+                    int px = colIndex[tableX];
+                    if (px < 0) { // zero-padded column
+                        fine[0] += delta * window;
+                        coarse[0] += delta * window;
+                        return;
                     }
-                }
+                    int offset = px * channels + c;
+                    for (const unsigned char* row : rows) {
+                        unsigned char v = row[offset];
+                        fine[v] += delta;
+                        coarse[v >> 4] += delta;
+                    }
+                    fine[0] += delta * zeroRows;
+                    coarse[0] += delta * zeroRows;
+                };
+
+                // Initial window around startX covers table positions [startX, startX + window)
+                for (int i = 0; i < window; ++i)
+                    updateColumn(startX + i, +1);
+
+                for (int x = startX; x < endX; ++x) {
+                    if (x > startX) {
+                        updateColumn(x - 1, -1);
+                        updateColumn(x + window - 1, +1);
+                    }
+
+                    int bin = 0, seen = 0;
+                    while (seen + coarse[bin] <= rank) seen += coarse[bin++];
+                    int value = bin << 4;
+                    while (seen + fine[value] <= rank) seen += fine[value++];
 
-                std::sort(neighborhood.begin(), neighborhood.end());
-                int outIdx = (y * width + x) * channels + c;
-                output[outIdx] = neighborhood.empty() ? 0 : neighborhood[neighborhood.size() / 2];
+                    output[(y * width + x) * channels + c] = static_cast<unsigned char>(value);
+                }
             }
         }
-    }
+    }, kMinBandRows);
 
     return output;
 }
@@ -145,7 +307,9 @@ std::vector<unsigned char> SpatialTransformation::laplacianFullCore(const std::v
 
 std::vector<unsigned char> SpatialTransformation::sobelCore(const std::vector<unsigned char>& input, 
                                                             int width, int height, int channels, PaddingType padding) {
+    IIPT_PROFILE_PHASE("sobelCore");
     std::vector<unsigned char> output(width * height * channels, 0);
+    IIPT_PROFILE_ALLOC(output.size());
 
     std::vector<std::vector<int>> Gx = {
         {-1, 0, 1},
@@ -159,24 +323,26 @@ std::vector<unsigned char> SpatialTransformation::sobelCore(const std::vector<un
         { 1,  2,  1}
     };
 
-    for (int y = 1; y < height - 1; ++y) {
-        for (int x = 1; x < width - 1; ++x) {
-            for (int c = 0; c < channels; ++c) {
-                float gx = 0, gy = 0;
-                for (int ky = -1; ky <= 1; ++ky) {
-                    for (int kx = -1; kx <= 1; ++kx) {
-                        int px = x + kx;
-                        int py = y + ky;
-                        int idx = (py * width + px) * channels + c;
-                        gx += input[idx] * Gx[ky + 1][kx + 1];
-                        gy += input[idx] * Gy[ky + 1][kx + 1];
+    ThreadPool::parallelFor(1, height - 1, [&](int bandBegin, int bandEnd) {
+        for (int y = bandBegin; y < bandEnd; ++y) {
+            for (int x = 1; x < width - 1; ++x) {
+                for (int c = 0; c < channels; ++c) {
+                    float gx = 0, gy = 0;
+                    for (int ky = -1; ky <= 1; ++ky) {
+                        for (int kx = -1; kx <= 1; ++kx) {
+                            int px = x + kx;
+                            int py = y + ky;
+                            int idx = (py * width + px) * channels + c;
+                            gx += input[idx] * Gx[ky + 1][kx + 1];
+                            gy += input[idx] * Gy[ky + 1][kx + 1];
+                        }
                     }
+                    float mag = std::sqrt(gx * gx + gy * gy);
+                    output[(y * width + x) * channels + c] = static_cast<unsigned char>(std::clamp(mag, 0.0f, 255.0f));
                 }
-                float mag = std::sqrt(gx * gx + gy * gy);
-                output[(y * width + x) * channels + c] = static_cast<unsigned char>(std::clamp(mag, 0.0f, 255.0f));
             }
         }
-    }
+    }, kMinBandRows);
 
     return output;
 }
@@ -192,11 +358,15 @@ std::vector<unsigned char> SpatialTransformation::sharpeningCore(const std::vect
     else if (method == "Sobel")                     edge = sobelCore(input, width, height, channels, padding);
     else throw std::runtime_error("Unknown sharpening method");
 
+    IIPT_PROFILE_PHASE("combine");
     std::vector<unsigned char> output(input.size());
-    for (size_t i = 0; i < input.size(); ++i) {
-        int val = static_cast<int>(input[i]) + static_cast<int>(edge[i]);
-        output[i] = static_cast<unsigned char>(std::clamp(val, 0, 255));
-    }
+    IIPT_PROFILE_ALLOC(output.size());
+    ThreadPool::parallelFor(0, static_cast<int>(input.size()), [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            int val = static_cast<int>(input[i]) + static_cast<int>(edge[i]);
+            output[i] = static_cast<unsigned char>(std::clamp(val, 0, 255));
+        }
+    }, kMinCombineChunk);
 
     return output;
 }
@@ -212,12 +382,16 @@ std::vector<unsigned char> SpatialTransformation::unsharpMaskingCore(const std::
     else if (kernelType == "median")  blurred = medianFilterCore(input, width, height, channels, kernelSize, padding);
     else throw std::runtime_error("Unknown kernel type for unsharp masking");
 
+    IIPT_PROFILE_PHASE("combine");
     std::vector<unsigned char> output(input.size());
-    for (size_t i = 0; i < input.size(); ++i) {
-        int mask = static_cast<int>(input[i]) - static_cast<int>(blurred[i]);
-        int val = static_cast<int>(input[i]) + mask;
-        output[i] = static_cast<unsigned char>(std::clamp(val, 0, 255));
-    }
+    IIPT_PROFILE_ALLOC(output.size());
+    ThreadPool::parallelFor(0, static_cast<int>(input.size()), [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            int mask = static_cast<int>(input[i]) - static_cast<int>(blurred[i]);
+            int val = static_cast<int>(input[i]) + mask;
+            output[i] = static_cast<unsigned char>(std::clamp(val, 0, 255));
+        }
+    }, kMinCombineChunk);
 
     return output;
 }
@@ -233,12 +407,16 @@ std::vector<unsigned char> SpatialTransformation::highboostFilteringCore(const s
     else if (kernelType == "median")  blurred = medianFilterCore(input, width, height, channels, kernelSize, padding);
     else throw std::runtime_error("Unknown kernel type for highboost filtering");
 
+    IIPT_PROFILE_PHASE("combine");
     std::vector<unsigned char> output(input.size());
-    for (size_t i = 0; i < input.size(); ++i) {
-        int mask = static_cast<int>(input[i]) - static_cast<int>(blurred[i]);
-        int val = static_cast<int>(input[i]) + static_cast<int>(K * mask);
-        output[i] = static_cast<unsigned char>(std::clamp(val, 0, 255));
-    }
+    IIPT_PROFILE_ALLOC(output.size());
+    ThreadPool::parallelFor(0, static_cast<int>(input.size()), [&](int begin, int end) {
+        for (int i = begin; i < end; ++i) {
+            int mask = static_cast<int>(input[i]) - static_cast<int>(blurred[i]);
+            int val = static_cast<int>(input[i]) + static_cast<int>(K * mask);
+            output[i] = static_cast<unsigned char>(std::clamp(val, 0, 255));
+        }
+    }, kMinCombineChunk);
 
     return output;
 }
@@ -265,57 +443,184 @@ std::vector<std::vector<float>> SpatialTransformation::generateGaussianKernel(in
     return kernel;
 }
 
+std::vector<float> SpatialTransformation::generateGaussianKernel1D(int size, float sigma) {
+    // The 2-D Gaussian is the outer product of this kernel with itself, so running it
+    // horizontally and then vertically gives the same weights as generateGaussianKernel().
+    int k = size / 2;
+    std::vector<float> kernel(size);
+    float sum = 0.0f;
+
+    for (int x = -k; x < size - k; ++x) {
+        float value = std::exp(-(x * x) / (2 * sigma * sigma));
+        kernel[x + k] = value;
+        sum += value;
+    }
+
+    for (auto& val : kernel)
+        val /= sum;
+
+    return kernel;
+}
+
+std::vector<unsigned char> SpatialTransformation::convolveSeparable(const std::vector<unsigned char>& input,
+                                                                    int width, int height, int channels,
+                                                                    const std::vector<float>& kernelX,
+                                                                    const std::vector<float>& kernelY,
+                                                                    PaddingType padding)
+{
+    IIPT_PROFILE_PHASE("convolveSeparable");
+    int kx = kernelX.size() / 2;
+    int ky = kernelY.size() / 2;
+    std::vector<unsigned char> output(width * height * channels, 0);
+    IIPT_PROFILE_ALLOC(output.size());
+
+    // Same output region as convolve(): with no padding only fully covered pixels are written.
+    int startY = (padding == PaddingType::None) ? ky : 0;
+    int endY   = (padding == PaddingType::None) ? height - ky : height;
+    int startX = (padding == PaddingType::None) ? kx : 0;
+    int endX   = (padding == PaddingType::None) ? width - kx : width;
+    if (startX >= endX || startY >= endY) return output;
+
+    std::vector<int> colIndex = buildIndexTable(width, kx, padding);
+    std::vector<int> rowIndex = buildIndexTable(height, ky, padding);
+
+    // Horizontal pass into a float buffer. Every row is needed by the vertical pass.
+    // Columns whose taps all lie inside the row run tap by tap over contiguous memory;
+    // only the few border columns go through the padding table.
+    int sizeX = kernelX.size();
+    int interiorX0 = std::min(std::max(startX, kx), endX);
+    int interiorX1 = std::max(interiorX0, std::min(endX, width - (sizeX - 1 - kx)));
+    std::vector<float> temp(width * height * channels, 0.0f);
+    IIPT_PROFILE_ALLOC(temp.size() * sizeof(float));
+    ThreadPool::parallelFor(0, height, [&](int bandBegin, int bandEnd) {
+        for (int y = bandBegin; y < bandEnd; ++y) {
+            const unsigned char* src = &input[y * width * channels];
+            float* dst = &temp[y * width * channels];
+
+            auto borderColumn = [&](int x) {
+                for (int c = 0; c < channels; ++c) {
+                    float sum = 0.0f;
+                    for (int i = 0; i < sizeX; ++i) {
+                        int px = colIndex[x + i];
+                        if (px < 0) continue; // zero padding
+                        sum += src[px * channels + c] * kernelX[i];
+                    }
+                    dst[x * channels + c] = sum;
+                }
+            };
+
+            for (int x = startX; x < interiorX0; ++x) borderColumn(x);
+            for (int i = 0; i < sizeX; ++i) {
+                int offset = (i - kx) * channels;
+                float weight = kernelX[i];
+                for (int j = interiorX0 * channels; j < interiorX1 * channels; ++j)
+                    dst[j] += src[j + offset] * weight;
+            }
+            for (int x = interiorX1; x < endX; ++x) borderColumn(x);
+        }
+    }, kMinBandRows);
+
+    // Vertical pass: accumulate whole rows so the inner loop is a contiguous multiply-add.
+    int rowBegin = startX * channels;
+    int rowEnd   = endX * channels;
+    ThreadPool::parallelFor(startY, endY, [&](int bandBegin, int bandEnd) {
+        std::vector<float> acc(width * channels);
+        for (int y = bandBegin; y < bandEnd; ++y) {
+            std::fill(acc.begin(), acc.end(), 0.0f);
+            for (size_t j = 0; j < kernelY.size(); ++j) {
+                int py = rowIndex[y + j];
+                if (py < 0) continue; // zero padding
+                const float* src = &temp[py * width * channels];
+                float weight = kernelY[j];
+                for (int i = rowBegin; i < rowEnd; ++i)
+                    acc[i] += src[i] * weight;
+            }
+
+            unsigned char* dst = &output[y * width * channels];
+            for (int i = rowBegin; i < rowEnd; ++i)
+                dst[i] = static_cast<unsigned char>(std::clamp(acc[i], 0.0f, 255.0f));
+        }
+    }, kMinBandRows);
+
+    return output;
+}
+
 std::vector<unsigned char> SpatialTransformation::convolve(const std::vector<unsigned char>& input,
                                                             int width, int height, int channels,
                                                             const std::vector<std::vector<float>>& kernel,
                                                             PaddingType padding)
 {
-    int k = kernel.size() / 2;
+    IIPT_PROFILE_PHASE("convolve");
+    int size = kernel.size();
+    int k = size / 2;
     std::vector<unsigned char> output(width * height * channels, 0);
+    IIPT_PROFILE_ALLOC(output.size());
 
     int startY = (padding == PaddingType::None) ? k : 0;
     int endY   = (padding == PaddingType::None) ? height - k : height;
     int startX = (padding == PaddingType::None) ? k : 0;
     int endX   = (padding == PaddingType::None) ? width - k : width;
+    if (startX >= endX || startY >= endY) return output;
+
+    // Non-zero taps in the row-major order the sum is accumulated in; skipping a zero
+    // weight leaves every partial sum unchanged.
+    struct Tap { int dy, dx; float weight; };
+    std::vector<Tap> taps;
+    for (int ky = -k; ky < size - k; ++ky)
+        for (int kx = -k; kx < size - k; ++kx)
+            if (kernel[ky + k][kx + k] != 0.0f)
+                taps.push_back({ky, kx, kernel[ky + k][kx + k]});
+
+    std::vector<int> colIndex = buildIndexTable(width, k, padding);
+    std::vector<int> rowIndex = buildIndexTable(height, k, padding);
+
+    // Border pixels: per-tap lookup through the padding tables.
+    auto borderPixel = [&](int y, int x) {
+        for (int c = 0; c < channels; ++c) {
+            float sum = 0.0f;
+            for (const Tap& t : taps) {
+                int px = colIndex[x + t.dx + k];
+                int py = rowIndex[y + t.dy + k];
+                if (px < 0 || py < 0) continue; // zero padding
+                sum += input[(py * width + px) * channels + c] * t.weight;
+            }
+            output[(y * width + x) * channels + c] = static_cast<unsigned char>(std::clamp(sum, 0.0f, 255.0f));
+        }
+    };
 
-    for (int y = startY; y < endY; ++y) {
-        for (int x = startX; x < endX; ++x) {
-            for (int c = 0; c < channels; ++c) {
-                float sum = 0.0f;
-
-                for (int ky = -k; ky <= k; ++ky) {
-                    for (int kx = -k; kx <= k; ++kx) {
-                        int px = x + kx;
-                        int py = y + ky;
-
-                        // Handle padding
-                        if (px < 0 || px >= width || py < 0 || py >= height) {
-                            if (padding == PaddingType::None) continue;
-                            else if (padding == PaddingType::Zero) {
-                                continue; // zero padding
-                            }
-                            else if (padding == PaddingType::Replicate) {
-                                px = std::clamp(px, 0, width - 1);
-                                py = std::clamp(py, 0, height - 1);
-                            }
-                            else if (padding == PaddingType::Mirror) {
-                                if (px < 0) px = -px;
-                                if (px >= width) px = 2 * width - px - 2;
-                                if (py < 0) py = -py;
-                                if (py >= height) py = 2 * height - py - 2;
-                            }
-                        }
-
-                        int idx = (py * width + px) * channels + c;
-                        sum += input[idx] * kernel[ky + k][kx + k];
-                    }
-                }
+    // Interior: every tap is in bounds, so each tap is one contiguous multiply-add over the row.
+    int rowLen = width * channels;
+    int interiorX0 = std::max(startX, k);
+    int interiorX1 = std::min(endX, width - (size - 1 - k));
+    int interiorY0 = std::max(startY, k);
+    int interiorY1 = std::min(endY, height - (size - 1 - k));
+    ThreadPool::parallelFor(startY, endY, [&](int bandBegin, int bandEnd) {
+        std::vector<float> acc(rowLen);
+        for (int y = bandBegin; y < bandEnd; ++y) {
+            if (y < interiorY0 || y >= interiorY1 || interiorX0 >= interiorX1) {
+                for (int x = startX; x < endX; ++x) borderPixel(y, x);
+                continue;
+            }
 
-                int outIdx = (y * width + x) * channels + c;
-                output[outIdx] = static_cast<unsigned char>(std::clamp(sum, 0.0f, 255.0f));
+            int begin = interiorX0 * channels;
+            int end   = interiorX1 * channels;
+            std::fill(acc.begin() + begin, acc.begin() + end, 0.0f);
+            for (const Tap& t : taps) {
+                const unsigned char* src = &input[(y + t.dy) * rowLen];
+                int offset = t.dx * channels;
+                float weight = t.weight;
+                for (int i = begin; i < end; ++i)
+                    acc[i] += src[i + offset] * weight;
             }
+
+            unsigned char* dst = &output[y * rowLen];
+            for (int i = begin; i < end; ++i)
+                dst[i] = static_cast<unsigned char>(std::clamp(acc[i], 0.0f, 255.0f));
+
+            for (int x = startX; x < interiorX0; ++x) borderPixel(y, x);
+            for (int x = interiorX1; x < endX; ++x) borderPixel(y, x);
         }
-    }
+    }, kMinBandRows);
 
     return output;
 }
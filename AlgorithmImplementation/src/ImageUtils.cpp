@@ -1,8 +1,12 @@
 #include "ImageUtils.h"
+#include "Profiler.h"
+#include "ThreadPool.h"
+#include <cstdint>
 #include <iostream>
 #include <cmath>
 #include <vector>
 #include <algorithm>
+#include <cstring>
 
 namespace iipt {
 
@@ -25,6 +29,45 @@ namespace iipt {
 }
 
 
+    int ImageUtils::borderIndex(int i, int n, PaddingType type) {
+        if (i >= 0 && i < n) return i;
+        switch (type) {
+        case PaddingType::Replicate:
+            return std::clamp(i, 0, n - 1);
+        case PaddingType::Mirror:
+            i = (i < 0) ? -i : 2 * n - i - 2;
+            return std::clamp(i, 0, n - 1); // halo wider than the axis
+        case PaddingType::None:
+        case PaddingType::Zero:
+        default:
+            return -1;
+        }
+    }
+
+    std::vector<int> ImageUtils::borderTable(int n, int before, int after, PaddingType type) {
+        std::vector<int> table(n + before + after);
+        for (int i = -before; i < n + after; ++i)
+            table[i + before] = borderIndex(i, n, type);
+        return table;
+    }
+
+    void ImageUtils::padRow(const unsigned char* src, int width, int channels,
+                            int firstColumn, int count, PaddingType type, unsigned char* dst) {
+        int innerBegin = std::clamp(-firstColumn, 0, count);
+        int innerEnd = std::clamp(width - firstColumn, innerBegin, count);
+        std::memcpy(dst + static_cast<size_t>(innerBegin) * channels,
+                    src + static_cast<size_t>(innerBegin + firstColumn) * channels,
+                    static_cast<size_t>(innerEnd - innerBegin) * channels);
+
+        auto haloPixel = [&](int i) {
+            int sx = borderIndex(i + firstColumn, width, type);
+            for (int c = 0; c < channels; ++c)
+                dst[static_cast<size_t>(i) * channels + c] = sx < 0 ? 0 : src[static_cast<size_t>(sx) * channels + c];
+        };
+        for (int i = 0; i < innerBegin; ++i) haloPixel(i);
+        for (int i = innerEnd; i < count; ++i) haloPixel(i);
+    }
+
     std::vector<unsigned char> ImageUtils::padImage(
         const std::vector<unsigned char>& data,
         int width, int height,
@@ -32,36 +75,25 @@ namespace iipt {
         int padX, int padY,
         PaddingType type
     ) {
+        IIPT_PROFILE_PHASE("padding");
         int newWidth = width + 2 * padX;
         int newHeight = height + 2 * padY;
-        std::vector<unsigned char> padded(newWidth * newHeight * channels, 0);
-
-        auto getPixel = [&](int x, int y, int c) -> unsigned char {
-            switch (type) {
-            case PaddingType::Zero:
-                if (x < 0 || y < 0 || x >= width || y >= height) return 0;
-                return data[(y * width + x) * channels + c];
-            case PaddingType::Replicate:
-                x = std::clamp(x, 0, width - 1);
-                y = std::clamp(y, 0, height - 1);
-                return data[(y * width + x) * channels + c];
-            case PaddingType::Mirror:
-                x = (x < 0) ? -x : (x >= width ? 2 * width - x - 2 : x);
-                y = (y < 0) ? -y : (y >= height ? 2 * height - y - 2 : y);
-                return data[(y * width + x) * channels + c];
-            case PaddingType::None:
-            default:
-                std::cerr << "Warning: PaddingType::None should not be used here. Returning zeros.\n";
-                return 0;
-            }
-        };
+        size_t rowLen = static_cast<size_t>(width) * channels;
+        size_t newRowLen = static_cast<size_t>(newWidth) * channels;
+        std::vector<unsigned char> padded(newRowLen * newHeight, 0);
+        IIPT_PROFILE_ALLOC(padded.size());
 
+        if (type == PaddingType::None) {
+            std::cerr << "Warning: PaddingType::None should not be used here. Returning zeros.\n";
+            return padded;
+        }
+
+        // Interior rows are copied, halo rows are copies of the rows the rule selects
+        std::vector<int> rowIndex = borderTable(height, padY, padY, type);
         for (int y = 0; y < newHeight; ++y) {
-            for (int x = 0; x < newWidth; ++x) {
-                for (int c = 0; c < channels; ++c) {
-                    padded[(y * newWidth + x) * channels + c] = getPixel(x - padX, y - padY, c);
-                }
-            }
+            int sy = rowIndex[y];
+            if (sy < 0) continue;
+            padRow(&data[sy * rowLen], width, channels, -padX, newWidth, type, &padded[y * newRowLen]);
         }
 
         return padded;
@@ -119,4 +151,51 @@ std::vector<std::vector<int>> ImageUtils::createStructuringElement(const std::st
         return se;
     }
 
+Image ImageUtils::downscale(const ImageView& src, int maxWidth, int maxHeight) {
+    IIPT_PROFILE_SCOPE("ImageUtils::downscale");
+    Image out;
+    if (src.empty() || src.width <= 0 || src.height <= 0 || maxWidth <= 0 || maxHeight <= 0) return out;
+    if (src.width <= maxWidth && src.height <= maxHeight) {
+        src.copyTo(out);
+        return out;
+    }
+
+    double scale = std::min(static_cast<double>(maxWidth) / src.width, static_cast<double>(maxHeight) / src.height);
+    int channels = src.channels;
+    out.width = std::max(1, static_cast<int>(src.width * scale));
+    out.height = std::max(1, static_cast<int>(src.height * scale));
+    out.channels = channels;
+    out.data.resize(static_cast<size_t>(out.width) * out.height * channels);
+    IIPT_PROFILE_ALLOC(out.data.size());
+
+    // Output column x averages source columns [xStart[x], xStart[x + 1]), same for rows
+    std::vector<int> xStart(out.width + 1), yStart(out.height + 1);
+    for (int x = 0; x <= out.width; ++x) xStart[x] = static_cast<int>(static_cast<long long>(x) * src.width / out.width);
+    for (int y = 0; y <= out.height; ++y) yStart[y] = static_cast<int>(static_cast<long long>(y) * src.height / out.height);
+
+    ThreadPool::parallelFor(0, out.height, [&](int y0, int y1) {
+        // Column sums of the source rows behind one output row, then summed per output pixel
+        std::vector<uint32_t> columnSums(static_cast<size_t>(src.width) * channels);
+        for (int y = y0; y < y1; ++y) {
+            std::fill(columnSums.begin(), columnSums.end(), 0u);
+            for (int sy = yStart[y]; sy < yStart[y + 1]; ++sy) {
+                const unsigned char* row = src.row(sy);
+                for (size_t i = 0; i < columnSums.size(); ++i) columnSums[i] += row[i];
+            }
+
+            int rows = yStart[y + 1] - yStart[y];
+            unsigned char* dst = &out.data[static_cast<size_t>(y) * out.width * channels];
+            for (int x = 0; x < out.width; ++x) {
+                uint64_t area = static_cast<uint64_t>(rows) * (xStart[x + 1] - xStart[x]);
+                for (int c = 0; c < channels; ++c) {
+                    uint64_t sum = 0;
+                    for (int sx = xStart[x]; sx < xStart[x + 1]; ++sx) sum += columnSums[static_cast<size_t>(sx) * channels + c];
+                    dst[x * channels + c] = static_cast<unsigned char>((sum + area / 2) / area);
+                }
+            }
+        }
+    }, 4);
+    return out;
+}
+
 }
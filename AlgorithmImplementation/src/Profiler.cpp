@@ -0,0 +1,151 @@
+#include "Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+
+namespace iipt {
+
+namespace {
+using Clock = std::chrono::steady_clock;
+
+std::atomic<bool> recording(false);
+std::atomic<int> nextThreadId(0);
+std::mutex eventsMutex;
+std::vector<Profiler::Event> recorded;
+Clock::time_point origin = Clock::now();
+
+thread_local Profiler::Scope* openScope = nullptr;
+
+int threadId() {
+    thread_local int id = nextThreadId.fetch_add(1);
+    return id;
+}
+
+double microseconds(Clock::duration d) {
+    return std::chrono::duration<double, std::micro>(d).count();
+}
+} // anonymous namespace
+
+void Profiler::setEnabled(bool on) {
+    recording.store(on && compiledIn());
+}
+
+bool Profiler::enabled() {
+    return recording.load(std::memory_order_relaxed);
+}
+
+void Profiler::reset() {
+    std::lock_guard<std::mutex> lock(eventsMutex);
+    recorded.clear();
+    origin = Clock::now();
+}
+
+size_t Profiler::eventCount() {
+    std::lock_guard<std::mutex> lock(eventsMutex);
+    return recorded.size();
+}
+
+std::vector<Profiler::Event> Profiler::events(size_t firstEvent) {
+    std::lock_guard<std::mutex> lock(eventsMutex);
+    if (firstEvent >= recorded.size()) return {};
+    return std::vector<Event>(recorded.begin() + firstEvent, recorded.end());
+}
+
+std::vector<Profiler::Summary> Profiler::summary(size_t firstEvent, int thread) {
+    std::map<std::pair<std::string, std::string>, Summary> byName;
+    for (const Event& e : events(firstEvent)) {
+        if (thread >= 0 && e.thread != thread) continue;
+        Summary& s = byName[{e.category, e.name}];
+        s.name = e.name;
+        s.category = e.category;
+        ++s.calls;
+        s.totalMs += e.durationUs / 1000.0;
+        s.maxMs = std::max(s.maxMs, e.durationUs / 1000.0);
+        s.allocations += e.allocations;
+        s.bytes += e.bytes;
+    }
+
+    std::vector<Summary> rows;
+    for (auto& entry : byName) rows.push_back(entry.second);
+    std::sort(rows.begin(), rows.end(), [](const Summary& a, const Summary& b) { return a.totalMs > b.totalMs; });
+    return rows;
+}
+
+int Profiler::currentThread() {
+    return threadId();
+}
+
+void Profiler::printSummary(std::ostream& out, size_t firstEvent) {
+    if (!compiledIn()) {
+        out << "Profiling not compiled in (configure with -DIIPT_PROFILE=ON)\n";
+        return;
+    }
+    char line[192];
+    std::snprintf(line, sizeof(line), "%-44s %-6s %7s %11s %10s %8s %12s\n",
+                  "name", "kind", "calls", "total ms", "max ms", "allocs", "bytes");
+    out << line;
+    for (const Summary& s : summary(firstEvent)) {
+        std::snprintf(line, sizeof(line), "%-44s %-6s %7zu %11.3f %10.3f %8zu %12zu\n",
+                      s.name.c_str(), s.category.c_str(), s.calls, s.totalMs, s.maxMs, s.allocations, s.bytes);
+        out << line;
+    }
+}
+
+bool Profiler::writeChromeTrace(const std::string& path) {
+    std::ofstream out(path);
+    if (!out) {
+        std::cerr << "Failed to write trace file: " << path << "\n";
+        return false;
+    }
+    out << "{\"traceEvents\":[\n";
+    std::vector<Event> all = events();
+    char line[384];
+    for (size_t i = 0; i < all.size(); ++i) {
+        const Event& e = all[i];
+        std::snprintf(line, sizeof(line),
+                      "{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f,"
+                      "\"args\":{\"depth\":%d,\"allocations\":%zu,\"bytes\":%zu}}%s\n",
+                      e.name, e.category, e.thread, e.startUs, e.durationUs, e.depth, e.allocations, e.bytes,
+                      i + 1 < all.size() ? "," : "");
+        out << line;
+    }
+    out << "],\"displayTimeUnit\":\"ms\"}\n";
+    return static_cast<bool>(out);
+}
+
+void Profiler::countAllocation(size_t bytes) {
+    if (Scope* scope = openScope) {
+        ++scope->allocations;
+        scope->bytes += bytes;
+    }
+}
+
+Profiler::Scope::Scope(const char* name, const char* category) : name(name), category(category) {
+    if (!enabled()) return;
+    active = true;
+    parent = openScope;
+    depth = parent ? parent->depth + 1 : 0;
+    openScope = this;
+    start = Clock::now();
+}
+
+Profiler::Scope::~Scope() {
+    if (!active) return;
+    Clock::time_point end = Clock::now();
+    openScope = parent;
+    if (parent) {
+        parent->allocations += allocations;
+        parent->bytes += bytes;
+    }
+
+    std::lock_guard<std::mutex> lock(eventsMutex);
+    recorded.push_back({name, category, threadId(), depth, microseconds(start - origin),
+                        microseconds(end - start), allocations, bytes});
+}
+
+} // namespace iipt
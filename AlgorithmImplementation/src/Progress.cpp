@@ -0,0 +1,34 @@
+#include "Progress.h"
+
+namespace iipt {
+
+namespace {
+thread_local ProgressToken* installedToken = nullptr;
+} // anonymous namespace
+
+ProgressToken* ProgressToken::current() {
+    return installedToken;
+}
+
+ProgressToken::Scope::Scope(ProgressToken* token) : previous(installedToken) {
+    installedToken = token;
+}
+
+ProgressToken::Scope::~Scope() {
+    installedToken = previous;
+}
+
+void ProgressToken::beginPass(int items) {
+    int pass = passes.fetch_add(1);
+    itemsDone.store(0);
+    passItems.store(items);
+    if (callback) callback(pass, 0.0);
+}
+
+void ProgressToken::advance(int items) {
+    int done = itemsDone.fetch_add(items) + items;
+    int total = passItems.load();
+    if (callback && total > 0) callback(passes.load() - 1, static_cast<double>(done) / total);
+}
+
+} // namespace iipt
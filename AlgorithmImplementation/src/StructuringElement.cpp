@@ -0,0 +1,69 @@
+#include "StructuringElement.h"
+#include <algorithm>
+
+namespace iipt {
+
+StructuringElement::StructuringElement() : cols(0), rows(0) {}
+
+StructuringElement::StructuringElement(const std::vector<std::vector<int>>& mask)
+    : cols(0), rows(static_cast<int>(mask.size())) {
+    for (const auto& row : mask)
+        cols = std::max(cols, static_cast<int>(row.size()));
+
+    int cx = centerX(), cy = centerY();
+    auto active = [&](int dy, int dx) {
+        int y = dy + cy, x = dx + cx;
+        return y >= 0 && y < rows && x >= 0 && x < static_cast<int>(mask[y].size()) && mask[y][x] == 1;
+    };
+
+    for (int y = 0; y < rows; ++y) {
+        for (int x = 0; x < static_cast<int>(mask[y].size()); ++x) {
+            if (mask[y][x] != 1) continue;
+            taps.push_back({x - cx, y - cy});
+            if (x == 0 || mask[y][x - 1] != 1)
+                rowRuns.push_back({y - cy, x - cx, x - cx});
+            else
+                rowRuns.back().dx1 = x - cx;
+        }
+    }
+
+    // Grow every run vertically while the rows above / below cover it entirely. Each tap
+    // lies in its own run's rectangle and every rectangle holds only active taps, so the
+    // union is exact; runs of equal extent in a convex shape collapse to the same rectangle.
+    auto covers = [&](int dy, const Run& run) {
+        for (int dx = run.dx0; dx <= run.dx1; ++dx)
+            if (!active(dy, dx)) return false;
+        return true;
+    };
+    std::vector<Rect> grown;
+    for (const Run& run : rowRuns) {
+        Rect r{run.dx0, run.dy, run.dx1, run.dy};
+        while (covers(r.dy0 - 1, run)) --r.dy0;
+        while (covers(r.dy1 + 1, run)) ++r.dy1;
+        grown.push_back(r);
+    }
+
+    auto contains = [](const Rect& outer, const Rect& inner) {
+        return outer.dx0 <= inner.dx0 && outer.dx1 >= inner.dx1 && outer.dy0 <= inner.dy0 && outer.dy1 >= inner.dy1;
+    };
+    for (size_t i = 0; i < grown.size(); ++i) {
+        bool redundant = false;
+        for (size_t j = 0; j < grown.size() && !redundant; ++j) {
+            if (i == j || !contains(grown[j], grown[i])) continue;
+            // Of two identical rectangles keep the first
+            redundant = !contains(grown[i], grown[j]) || j < i;
+        }
+        if (!redundant) rects.push_back(grown[i]);
+    }
+}
+
+std::vector<std::ptrdiff_t> StructuringElement::linearOffsets(size_t stride, int channels) const {
+    std::vector<std::ptrdiff_t> linear;
+    linear.reserve(taps.size());
+    for (const Offset& o : taps)
+        linear.push_back(static_cast<std::ptrdiff_t>(o.dy) * static_cast<std::ptrdiff_t>(stride) +
+                         static_cast<std::ptrdiff_t>(o.dx) * channels);
+    return linear;
+}
+
+}
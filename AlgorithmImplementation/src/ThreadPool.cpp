@@ -0,0 +1,162 @@
+#include "ThreadPool.h"
+#include "Progress.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <exception>
+
+namespace iipt {
+
+namespace {
+int defaultThreadCount() {
+    if (const char* env = std::getenv("IIPT_NUM_THREADS")) {
+        int n = std::atoi(env);
+        if (n > 0) return n;
+    }
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+// With a ProgressToken installed, top-level loops are cut into at least this many bands
+// so progress and cancellation are not limited to one step per thread
+constexpr int kProgressBands = 64;
+
+// Nesting of bands on this thread; only loops started outside any band report progress
+thread_local int bandDepth = 0;
+
+// Runs a band with the caller's token installed, whichever thread picks it up
+class BandContext {
+    public:
+        explicit BandContext(ProgressToken* token) : scope(token) { ++bandDepth; }
+        ~BandContext() { --bandDepth; }
+
+    private:
+        ProgressToken::Scope scope;
+};
+} // anonymous namespace
+
+ThreadPool& ThreadPool::instance() {
+    static ThreadPool pool;
+    static std::once_flag started;
+    std::call_once(started, [] { pool.start(defaultThreadCount()); });
+    return pool;
+}
+
+ThreadPool::~ThreadPool() {
+    stop();
+}
+
+void ThreadPool::setThreadCount(int count) {
+    ThreadPool& pool = instance();
+    pool.stop();
+    pool.start(count > 0 ? count : defaultThreadCount());
+}
+
+int ThreadPool::threadCount() {
+    return instance().threads;
+}
+
+void ThreadPool::start(int count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = false;
+    threads = std::max(1, count);
+    // The calling thread always works on a band too, so spawn one fewer worker.
+    for (int i = 1; i < threads; ++i)
+        workers.emplace_back([this] { workerLoop(); });
+}
+
+void ThreadPool::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    for (auto& worker : workers)
+        worker.join();
+    workers.clear();
+}
+
+// Pops and runs one queued task with the lock released. Returns false if the queue is empty.
+bool ThreadPool::runOneTask(std::unique_lock<std::mutex>& lock) {
+    if (tasks.empty()) return false;
+    std::function<void()> task = std::move(tasks.front());
+    tasks.pop_front();
+    lock.unlock();
+    task();
+    lock.lock();
+    taskFinished.notify_all();
+    return true;
+}
+
+void ThreadPool::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        taskAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+        if (stopping && tasks.empty()) return;
+        runOneTask(lock);
+    }
+}
+
+void ThreadPool::parallelFor(int begin, int end, const std::function<void(int, int)>& body, int minBand) {
+    if (end <= begin) return;
+
+    ThreadPool& pool = instance();
+    ProgressToken* token = ProgressToken::current();
+    bool reporting = token && bandDepth == 0;
+    if (token) token->throwIfCancelled();
+
+    int count = end - begin;
+    int maxBands = std::max(1, count / std::max(1, minBand));
+    int bands = std::min(reporting ? std::max(pool.threads, kProgressBands) : pool.threads, maxBands);
+    if (reporting) token->beginPass(count);
+    if (bands <= 1) {
+        {
+            BandContext context(token);
+            body(begin, end);
+        }
+        if (reporting) token->advance(count);
+        return;
+    }
+
+    std::atomic<int> pending(bands);
+    std::exception_ptr error;
+    std::mutex errorMutex;
+
+    auto runBand = [&](int band) {
+        int bandBegin = begin + static_cast<int>(static_cast<long long>(count) * band / bands);
+        int bandEnd   = begin + static_cast<int>(static_cast<long long>(count) * (band + 1) / bands);
+        try {
+            BandContext context(token);
+            if (!token || !token->cancelled()) {
+                body(bandBegin, bandEnd);
+                if (reporting) token->advance(bandEnd - bandBegin);
+            }
+        } catch (...) {
+            std::lock_guard<std::mutex> lock(errorMutex);
+            if (!error) error = std::current_exception();
+        }
+        pending.fetch_sub(1);
+    };
+
+    {
+        std::lock_guard<std::mutex> lock(pool.mutex);
+        for (int band = 1; band < bands; ++band)
+            pool.tasks.emplace_back([&runBand, band] { runBand(band); });
+    }
+    pool.taskAvailable.notify_all();
+
+    runBand(0);
+
+    // Help with queued work while waiting, so nested or concurrent calls cannot starve.
+    std::unique_lock<std::mutex> lock(pool.mutex);
+    while (pending.load() > 0) {
+        if (!pool.runOneTask(lock))
+            pool.taskFinished.wait(lock, [&] { return pending.load() == 0 || !pool.tasks.empty(); });
+    }
+    lock.unlock();
+
+    if (error) std::rethrow_exception(error);
+    if (token) token->throwIfCancelled();
+}
+
+} // namespace iipt
@@ -1,5 +1,20 @@
 #include "ImageQtAdapter.h"
+#include <cstring>
 #include <stdexcept>
+#include <utility>
+
+namespace {
+QImage::Format formatFor(int channels) {
+    if (channels == 1) return QImage::Format_Grayscale8;
+    if (channels == 3) return QImage::Format_RGB888;
+    throw std::runtime_error("Only 1- and 3-channel images can be converted to QImage.");
+}
+
+// Cleanup function of a QImage that owns a moved-in iipt::Image
+void releaseImage(void* info) {
+    delete static_cast<iipt::Image*>(info);
+}
+} // anonymous namespace
 
 iipt::Image ImageQtAdapter::fromQImage(const QImage& qimage) {
     iipt::Image img;
@@ -7,20 +22,41 @@ iipt::Image ImageQtAdapter::fromQImage(const QImage& qimage) {
     img.width = qimage.width();
     img.height = qimage.height();
     img.channels = qimage.isGrayscale() ? 1 : 3;
-    img.data.resize(img.width * img.height * img.channels);
+    img.data.resize(static_cast<size_t>(img.width) * img.height * img.channels);
+    if (qimage.isNull()) return img;
+
+    QImage source = qimage;
+    QImage::Format format = qimage.format();
+    if (format != QImage::Format_Grayscale8 && format != QImage::Format_RGB888 &&
+        format != QImage::Format_RGB32 && format != QImage::Format_ARGB32) {
+        source = qimage.convertToFormat(QImage::Format_RGB32);
+        format = QImage::Format_RGB32;
+    }
 
-    for (int y = 0; y < qimage.height(); ++y) {
-        for (int x = 0; x < qimage.width(); ++x) {
-            QRgb pixel = qimage.pixel(x, y);
-            int index = y * img.width + x;
+    size_t rowLen = static_cast<size_t>(img.width) * img.channels;
+    for (int y = 0; y < img.height; ++y) {
+        const uchar* src = source.constScanLine(y);
+        unsigned char* dst = &img.data[rowLen * y];
 
+        if (format == QImage::Format_Grayscale8) {
+            std::memcpy(dst, src, rowLen);
+        } else if (format == QImage::Format_RGB888) {
+            if (img.channels == 3) {
+                std::memcpy(dst, src, rowLen);
+            } else {
+                // All pixels are gray, so R == G == B
+                for (int x = 0; x < img.width; ++x) dst[x] = src[3 * x];
+            }
+        } else {
+            const QRgb* pixels = reinterpret_cast<const QRgb*>(src);
             if (img.channels == 1) {
-                img.data[index] = qGray(pixel);
+                for (int x = 0; x < img.width; ++x) dst[x] = qGray(pixels[x]);
             } else {
-                index *= 3;
-                img.data[index]     = qRed(pixel);
-                img.data[index + 1] = qGreen(pixel);
-                img.data[index + 2] = qBlue(pixel);
+                for (int x = 0; x < img.width; ++x) {
+                    dst[3 * x]     = qRed(pixels[x]);
+                    dst[3 * x + 1] = qGreen(pixels[x]);
+                    dst[3 * x + 2] = qBlue(pixels[x]);
+                }
             }
         }
     }
@@ -29,17 +65,65 @@ iipt::Image ImageQtAdapter::fromQImage(const QImage& qimage) {
 }
 
 QImage ImageQtAdapter::toQImage(const iipt::Image& image) {
-    if (image.channels == 1) {
-        QImage qimage(image.width, image.height, QImage::Format_Grayscale8);
-        for (int y = 0; y < image.height; ++y) {
-            for (int x = 0; x < image.width; ++x) {
-                int index = y * image.width + x;
-                uchar val = image.data[index];
-                qimage.setPixel(x, y, qRgb(val, val, val));
-            }
+    QImage qimage(image.width, image.height, formatFor(image.channels));
+    size_t rowLen = static_cast<size_t>(image.width) * image.channels;
+    for (int y = 0; y < image.height; ++y)
+        std::memcpy(qimage.scanLine(y), &image.data[rowLen * y], rowLen);
+    return qimage;
+}
+
+QImage ImageQtAdapter::toQImage(iipt::Image&& image) {
+    QImage::Format format = formatFor(image.channels);
+    if (image.data.empty()) return QImage();
+
+    iipt::Image* owner = new iipt::Image(std::move(image));
+    int bytesPerLine = owner->width * owner->channels;
+    return QImage(owner->data.data(), owner->width, owner->height, bytesPerLine, format,
+                  releaseImage, owner);
+}
+
+QImage ImageQtAdapter::toQImage(const iipt::Image& image, QImage::Format format) {
+    if (format != QImage::Format_RGB32 && format != QImage::Format_ARGB32) {
+        QImage qimage = toQImage(image);
+        return qimage.format() == format ? qimage : qimage.convertToFormat(format);
+    }
+    if (image.channels != 1 && image.channels != 3)
+        throw std::runtime_error("Only 1- and 3-channel images can be converted to QImage.");
+
+    QImage qimage(image.width, image.height, format);
+    size_t rowLen = static_cast<size_t>(image.width) * image.channels;
+    for (int y = 0; y < image.height; ++y) {
+        const unsigned char* src = &image.data[rowLen * y];
+        QRgb* dst = reinterpret_cast<QRgb*>(qimage.scanLine(y));
+        if (image.channels == 1) {
+            for (int x = 0; x < image.width; ++x) dst[x] = qRgb(src[x], src[x], src[x]);
+        } else {
+            for (int x = 0; x < image.width; ++x) dst[x] = qRgb(src[3 * x], src[3 * x + 1], src[3 * x + 2]);
         }
-        return qimage;
-    } else {
-        throw std::runtime_error("Only grayscale images are supported for now.");
     }
+    return qimage;
+}
+
+QImage ImageQtAdapter::wrap(iipt::Image& image) {
+    return QImage(image.data.data(), image.width, image.height,
+                  image.width * image.channels, formatFor(image.channels));
+}
+
+QImage ImageQtAdapter::wrap(const iipt::Image& image) {
+    return QImage(image.data.data(), image.width, image.height,
+                  image.width * image.channels, formatFor(image.channels));
+}
+
+iipt::ImageView ImageQtAdapter::view(const QImage& qimage) {
+    iipt::ImageView v;
+    int channels = qimage.format() == QImage::Format_Grayscale8 ? 1
+                 : qimage.format() == QImage::Format_RGB888 ? 3 : 0;
+    if (channels == 0 || qimage.isNull()) return v;
+
+    v.width = qimage.width();
+    v.height = qimage.height();
+    v.channels = channels;
+    v.stride = static_cast<size_t>(qimage.bytesPerLine());
+    v.data = qimage.constBits();
+    return v;
 }
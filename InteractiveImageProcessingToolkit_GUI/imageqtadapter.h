@@ -4,13 +4,31 @@
 #include <QImage>
 #include "ImageIO.h"  // From AlgorithmImplementation/include
 
+// Conversions between QImage and iipt::Image. Rows are copied through scanLine /
+// constScanLine; Grayscale8 and RGB888 have the same byte layout as a 1- or 3-channel
+// iipt::Image, so those rows are plain memcpy and can also be shared without a copy.
 class ImageQtAdapter {
 public:
-    // Convert QImage to iipt::Image
+    // Convert QImage to iipt::Image: 1 channel if the image is grayscale, else RGB.
+    // Grayscale8, RGB888, RGB32 and ARGB32 are read directly, other formats via RGB32.
     static iipt::Image fromQImage(const QImage& qimage);
 
-    // Convert iipt::Image to QImage
+    // Convert iipt::Image to QImage (Grayscale8 for 1 channel, RGB888 for 3)
     static QImage toQImage(const iipt::Image& image);
+    // Same, but the QImage takes over the pixel buffer instead of copying it
+    static QImage toQImage(iipt::Image&& image);
+    // Convert to a specific format; RGB32 / ARGB32 are written directly
+    static QImage toQImage(const iipt::Image& image, QImage::Format format);
+
+    // QImage over image.data without a copy. The image must outlive the QImage and must
+    // not be resized meanwhile; the const overload gives a read-only QImage.
+    static QImage wrap(iipt::Image& image);
+    static QImage wrap(const iipt::Image& image);
+
+    // Read-only view over the pixels of a Grayscale8 or RGB888 QImage, keeping its
+    // bytesPerLine as the stride; empty for other formats. Valid while qimage is
+    // alive and unmodified.
+    static iipt::ImageView view(const QImage& qimage);
 };
 
 #endif // IMAGE_QT_ADAPTER_H
@@ -5,12 +5,56 @@
 #include <QPixmap>
 #include <QMessageBox>
 #include <QSettings>
+#include <QStringList>
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
 
 #include "ImageIntensityTransformation.h"
 #include "ImageSpatialTransformation.h"
 #include "ImageQtAdapter.h"
 #include "ImageConverter.h"
 
+namespace {
+// Parameter changes closer together than this are previewed once
+constexpr int kPreviewDelayMs = 20;
+
+// Odd window size covering the same share of the image at the given scale, at least
+// `minimum` and at most the full-size value
+int previewKernelSize(int size, double scale, int minimum = 1)
+{
+    int scaled = static_cast<int>(std::lround(size * scale)) | 1;
+    return std::min(size, std::max(minimum, scaled));
+}
+
+float previewSigma(float sigma, double scale)
+{
+    return std::min(sigma, std::max(0.3f, static_cast<float>(sigma * scale)));
+}
+
+// resultImage shrunk to fit `bounds`, with the channel count fromQImage would give it.
+// Grayscale8 / RGB888 images are read in place, other formats are converted first.
+iipt::Image makeProxy(const QImage& source, const QSize& bounds)
+{
+    iipt::ImageView view = ImageQtAdapter::view(source);
+    iipt::Image converted;
+    if (view.empty()) {
+        converted = ImageQtAdapter::fromQImage(source);
+        view = iipt::ImageView{converted.width, converted.height, converted.channels,
+                               static_cast<size_t>(converted.width) * converted.channels, converted.data.data()};
+    }
+
+    iipt::Image proxy = iipt::ImageUtils::downscale(view, bounds.width(), bounds.height());
+    if (proxy.channels == 3 && source.isGrayscale()) {
+        for (size_t i = 0; i < proxy.data.size() / 3; ++i) proxy.data[i] = proxy.data[3 * i];
+        proxy.data.resize(proxy.data.size() / 3);
+        proxy.channels = 1;
+    }
+    return proxy;
+}
+} // anonymous namespace
+
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
@@ -34,10 +78,42 @@ MainWindow::MainWindow(QWidget *parent)
     ui->sigmaDoubleSpinBox_2->setEnabled(false);
     ui->sigmaLabel_2->setEnabled(false);
 
+    timingLabel = new QLabel(this);
+    ui->statusbar->addPermanentWidget(timingLabel);
+
+    progressBar = new QProgressBar(this);
+    progressBar->setRange(0, 100);
+    progressBar->setMaximumWidth(220);
+    progressBar->hide();
+    cancelButton = new QPushButton("Cancel", this);
+    cancelButton->hide();
+    ui->statusbar->addPermanentWidget(progressBar);
+    ui->statusbar->addPermanentWidget(cancelButton);
+    connect(cancelButton, &QPushButton::clicked, this, &MainWindow::cancelOperation);
+
+    // One job computes at a time; a second thread lets a new request start while a
+    // cancelled job is still winding down to its next band boundary
+    operationPool.setMaxThreadCount(2);
+
+    QSettings settings("Truoyon", "Interactive_Image_Processing_Toolkit");
+    qulonglong undoMemoryMB = settings.value("undoMemoryMB", 512).toULongLong();
+    history.setMemoryBudget(static_cast<size_t>(undoMemoryMB) << 20);
+
+    previewCheckBox = new QCheckBox("Live preview", this);
+    previewCheckBox->setChecked(true);
+    ui->statusbar->insertPermanentWidget(0, previewCheckBox);
+    previewPool.setMaxThreadCount(2);
+    previewTimer.setSingleShot(true);
+    previewTimer.setInterval(kPreviewDelayMs);
+    connectPreview();
 }
 
 MainWindow::~MainWindow()
 {
+    cancelOperation();
+    cancelPreview();
+    operationPool.waitForDone();
+    previewPool.waitForDone();
     delete ui;
 }
 
@@ -45,20 +121,331 @@ MainWindow::~MainWindow()
 
 // ------------------------- Helpers -------------------------
 
-void MainWindow::pushToUndoStack()
+void MainWindow::pushToUndoStack(iipt::ImageHistory::Delta delta)
 {
-    if (!resultImage.isNull()) {
-        undoStack.push(resultImage);
-        redoStack.clear();
-    }
+    history.push(std::move(delta));
 }
 
 void MainWindow::displayResult()
 {
+    cancelPreview();
+    previewShown = false;
+    ui->labelResultText->setText("Result");
     ui->labelResult->setPixmap(QPixmap::fromImage(resultImage).scaled(
         ui->labelResult->size(),
         Qt::KeepAspectRatio,
         Qt::SmoothTransformation));
+    showOperationTime();
+}
+
+// "Last operation: 12.4 ms", and with a profiling build the core calls behind it,
+// e.g. "applyGaussianFilter 11.9 ms (convolveSeparable 11.7, padding 0.1)". Only events
+// recorded on the job's own thread count, so previews running alongside are left out.
+void MainWindow::showOperationTime()
+{
+    if (!operationTimer.isValid()) return;
+    double totalMs = operationTimer.nsecsElapsed() / 1.0e6;
+    operationTimer.invalidate();
+
+    QString text = QString("Last operation: %1 ms").arg(totalMs, 0, 'f', 1);
+    QStringList ops, phases;
+    std::vector<iipt::Profiler::Summary> summary = iipt::Profiler::summary(0, profileThread);
+    stopProfiling();
+    for (const iipt::Profiler::Summary& s : summary) {
+        QString name = QString::fromStdString(s.name).section("::", -1);
+        if (s.category == "op")
+            ops << QString("%1 %2 ms").arg(name).arg(s.totalMs, 0, 'f', 1);
+        else if (s.category == "phase")
+            phases << QString("%1 %2").arg(name).arg(s.totalMs, 0, 'f', 1);
+    }
+    if (!ops.isEmpty()) {
+        text += " | " + ops.join(", ");
+        if (!phases.isEmpty()) text += " (" + phases.join(", ") + ")";
+    }
+    timingLabel->setText(text);
+}
+
+// Recording runs only while an operation does, and its events are dropped afterwards,
+// so a long session does not accumulate them
+void MainWindow::stopProfiling()
+{
+    iipt::Profiler::setEnabled(false);
+    iipt::Profiler::reset();
+}
+
+// ------------------- Background execution -----------------
+
+void MainWindow::runOperation(Operation operation)
+{
+    if (resultImage.isNull()) return;
+
+    // A preview already shown stays up until the full-size result replaces it
+    cancelPreview();
+    if (runningToken) runningToken->cancel();
+    quint64 job = ++currentJob;
+    QImage source = resultImage;
+
+    // The token calls back from core worker threads; progress is posted to the UI thread
+    runningToken = std::make_shared<iipt::ProgressToken>([this, job](int pass, double fraction) {
+        int percent = static_cast<int>(fraction * 100.0);
+        QMetaObject::invokeMethod(this, [this, job, pass, percent] { updateProgress(job, pass, percent); },
+                                  Qt::QueuedConnection);
+    });
+    std::shared_ptr<iipt::ProgressToken> token = runningToken;
+
+    progressPass = 0;
+    progressBar->setFormat("%p%");
+    progressBar->setValue(0);
+    progressBar->show();
+    cancelButton->show();
+    ui->statusbar->showMessage("Working...");
+    operationTimer.start();
+    iipt::Profiler::reset();
+    iipt::Profiler::setEnabled(iipt::Profiler::compiledIn());
+
+    operationPool.start([this, job, token, source, operation] {
+        int thread = iipt::Profiler::currentThread();
+        try {
+            iipt::Image img = ImageQtAdapter::fromQImage(source);
+            {
+                iipt::ProgressToken::Scope scope(token.get());
+                operation(img);
+                token->throwIfCancelled();
+            }
+            QImage result = ImageQtAdapter::toQImage(std::move(img));
+
+            // The undo delta is built here too, so the UI thread only stores it
+            iipt::Image converted;
+            iipt::ImageView before = ImageQtAdapter::view(source);
+            if (before.empty()) {
+                converted = ImageQtAdapter::fromQImage(source);
+                before = iipt::ImageView{converted.width, converted.height, converted.channels,
+                                         static_cast<size_t>(converted.width) * converted.channels,
+                                         converted.data.data()};
+            }
+            auto delta = std::make_shared<iipt::ImageHistory::Delta>(
+                iipt::ImageHistory::encode(before, ImageQtAdapter::view(result)));
+
+            QMetaObject::invokeMethod(this, [this, job, result, delta, thread] {
+                finishOperation(job, result, delta, thread);
+            }, Qt::QueuedConnection);
+        } catch (const iipt::OperationCancelled&) {
+            // Superseded or cancelled; the UI has moved on already
+        } catch (const std::exception& e) {
+            QString message = QString::fromUtf8(e.what());
+            QMetaObject::invokeMethod(this, [this, job, message] { failOperation(job, message); },
+                                      Qt::QueuedConnection);
+        }
+    });
+}
+
+void MainWindow::updateProgress(quint64 job, int pass, int percent)
+{
+    if (job != currentJob || !runningToken) return;
+    // Bands finish out of order, so only move forward within a pass
+    if (pass == progressPass && percent < progressBar->value()) return;
+    if (pass != progressPass) {
+        progressPass = pass;
+        progressBar->setFormat(QString("Pass %1: %p%").arg(pass + 1));
+    }
+    progressBar->setValue(percent);
+}
+
+void MainWindow::finishOperation(quint64 job, const QImage& result,
+                                 std::shared_ptr<iipt::ImageHistory::Delta> delta, int thread)
+{
+    if (job != currentJob || !runningToken) return;
+    stopProgress();
+    profileThread = thread;
+
+    pushToUndoStack(std::move(*delta));
+    resultImage = result;
+    displayResult();
+    updateImageInfo();
+    showDoneMessage();
+}
+
+void MainWindow::failOperation(quint64 job, const QString& message)
+{
+    if (job != currentJob || !runningToken) return;
+    stopProgress();
+    operationTimer.invalidate();
+    stopProfiling();
+    ui->statusbar->clearMessage();
+    QMessageBox::warning(this, "Operation failed", message);
+}
+
+// Cancels the running job, if any; a result it still delivers is ignored
+void MainWindow::cancelOperation()
+{
+    if (!runningToken) return;
+    runningToken->cancel();
+    ++currentJob;
+    stopProgress();
+    operationTimer.invalidate();
+    stopProfiling();
+    ui->statusbar->showMessage("Cancelled", 2000);
+}
+
+void MainWindow::stopProgress()
+{
+    runningToken.reset();
+    progressBar->hide();
+    cancelButton->hide();
+}
+
+// ------------------- Live preview -------------------------
+
+void MainWindow::connectPreview()
+{
+    auto preview = [this](OperationBuilder builder) {
+        return [this, builder] { schedulePreview(builder); };
+    };
+    auto spinChanged = QOverload<int>::of(&QSpinBox::valueChanged);
+    auto doubleSpinChanged = QOverload<double>::of(&QDoubleSpinBox::valueChanged);
+    auto comboChanged = QOverload<int>::of(&QComboBox::currentIndexChanged);
+
+    connect(ui->lineLogScalingFactor, &QLineEdit::textChanged, this, preview(&MainWindow::logOperation));
+    connect(ui->lineGammaScalingFactor, &QLineEdit::textChanged, this, preview(&MainWindow::gammaOperation));
+    connect(ui->lineGamma, &QLineEdit::textChanged, this, preview(&MainWindow::gammaOperation));
+    connect(ui->claheClipLimitSpinBox, doubleSpinChanged, this, preview(&MainWindow::claheOperation));
+    connect(ui->claheTilesSpinBox, spinChanged, this, preview(&MainWindow::claheOperation));
+
+    connect(ui->kernelTypeComboBox, comboChanged, this, preview(&MainWindow::lowHighPassOperation));
+    connect(ui->kernelSizeSpinBox, spinChanged, this, preview(&MainWindow::lowHighPassOperation));
+    connect(ui->sigmaDoubleSpinBox, doubleSpinChanged, this, preview(&MainWindow::lowHighPassOperation));
+    connect(ui->paddingTypeComboBox, comboChanged, this, preview(&MainWindow::lowHighPassOperation));
+
+    connect(ui->sharpeningMethodComboBox, comboChanged, this, preview(&MainWindow::sharpeningOperation));
+    connect(ui->paddingTypeComboBox_2, comboChanged, this, preview(&MainWindow::sharpeningOperation));
+
+    connect(ui->blurKernelComboBox, comboChanged, this, preview(&MainWindow::unsharpHighboostOperation));
+    connect(ui->kernelSizeSpinBox_3, spinChanged, this, preview(&MainWindow::unsharpHighboostOperation));
+    connect(ui->sigmaDoubleSpinBox_2, doubleSpinChanged, this, preview(&MainWindow::unsharpHighboostOperation));
+    connect(ui->gainDoubleSpinBox, doubleSpinChanged, this, preview(&MainWindow::unsharpHighboostOperation));
+    connect(ui->paddingTypeComboBox_3, comboChanged, this, preview(&MainWindow::unsharpHighboostOperation));
+
+    connect(ui->methodGrayscaleToBinaryComboBox, comboChanged, this, preview(&MainWindow::grayscaleToBinaryOperation));
+    connect(ui->thresholdValueSpinBox, spinChanged, this, preview(&MainWindow::grayscaleToBinaryOperation));
+    connect(ui->blockSizeSpinBox, spinChanged, this, preview(&MainWindow::grayscaleToBinaryOperation));
+    connect(ui->cSpinBox, spinChanged, this, preview(&MainWindow::grayscaleToBinaryOperation));
+    connect(ui->kDoubleSpinBox, doubleSpinChanged, this, preview(&MainWindow::grayscaleToBinaryOperation));
+
+    // The SE size slider drives spinBoxSeSize, so the spin box covers both
+    connect(ui->spinBoxSeSize, spinChanged, this, preview(&MainWindow::morphologyOperation));
+    for (QAbstractButton* button : {static_cast<QAbstractButton*>(ui->checkBoxGrayscaleMorphology),
+                                    static_cast<QAbstractButton*>(ui->radioButtonErosion),
+                                    static_cast<QAbstractButton*>(ui->radioButtonDilation),
+                                    static_cast<QAbstractButton*>(ui->radioButtonOpening),
+                                    static_cast<QAbstractButton*>(ui->radioButtonClosing),
+                                    static_cast<QAbstractButton*>(ui->radioButtonBoundaryExtraction),
+                                    static_cast<QAbstractButton*>(ui->radioButtonTopHat),
+                                    static_cast<QAbstractButton*>(ui->radioButtonBlackHat),
+                                    static_cast<QAbstractButton*>(ui->radioButtonGradient),
+                                    static_cast<QAbstractButton*>(ui->radioButtonSquare),
+                                    static_cast<QAbstractButton*>(ui->radioButtonCross),
+                                    static_cast<QAbstractButton*>(ui->radioButtonCircle),
+                                    static_cast<QAbstractButton*>(ui->radioButtonHorizontalLine),
+                                    static_cast<QAbstractButton*>(ui->radioButtonVerticalLine),
+                                    static_cast<QAbstractButton*>(ui->radioButtonNone),
+                                    static_cast<QAbstractButton*>(ui->radioButtonZero),
+                                    static_cast<QAbstractButton*>(ui->radioButtonReplicate),
+                                    static_cast<QAbstractButton*>(ui->radioButtonMirror)}) {
+        connect(button, &QAbstractButton::toggled, this, preview(&MainWindow::morphologyOperation));
+    }
+
+    connect(&previewTimer, &QTimer::timeout, this, &MainWindow::runPreview);
+    // Leaving a panel or switching the preview off shows the actual result again
+    connect(ui->stackedWidget, &QStackedWidget::currentChanged, this, [this] {
+        if (previewShown) displayResult();
+    });
+    connect(previewCheckBox, &QCheckBox::toggled, this, [this](bool on) {
+        if (!on && previewShown) displayResult();
+    });
+}
+
+void MainWindow::schedulePreview(OperationBuilder builder)
+{
+    if (!previewCheckBox->isChecked() || resultImage.isNull()) return;
+    previewBuilder = builder;
+    previewTimer.start();
+}
+
+void MainWindow::runPreview()
+{
+    if (!previewCheckBox->isChecked() || !previewBuilder || resultImage.isNull()) return;
+
+    QSize bounds = ui->labelResult->size();
+    bool proxyValid = proxyImage && proxyKey == resultImage.cacheKey() && proxyBounds == bounds;
+    double scale = std::min({1.0, static_cast<double>(bounds.width()) / resultImage.width(),
+                             static_cast<double>(bounds.height()) / resultImage.height()});
+    Operation operation = (this->*previewBuilder)(scale);
+    if (!operation) return;
+
+    if (previewToken) previewToken->cancel();
+    quint64 job = ++previewJob;
+    previewToken = std::make_shared<iipt::ProgressToken>();
+    std::shared_ptr<iipt::ProgressToken> token = previewToken;
+    std::shared_ptr<const iipt::Image> proxy = proxyValid ? proxyImage : nullptr;
+    QImage source = resultImage;
+    qint64 key = source.cacheKey();
+
+    previewPool.start([this, job, token, proxy, source, key, bounds, operation] {
+        std::shared_ptr<const iipt::Image> input = proxy;
+        if (!input) {
+            // Built outside the token, so a quick succession of changes cannot keep
+            // cancelling it; every later preview of this resultImage reuses it
+            input = std::make_shared<const iipt::Image>(makeProxy(source, bounds));
+            QMetaObject::invokeMethod(this, [this, input, key, bounds] {
+                if (key != resultImage.cacheKey()) return;
+                proxyImage = input;
+                proxyKey = key;
+                proxyBounds = bounds;
+            }, Qt::QueuedConnection);
+        }
+
+        iipt::ProgressToken::Scope scope(token.get());
+        try {
+            iipt::Image img = *input;
+            operation(img);
+            token->throwIfCancelled();
+            QImage preview = ImageQtAdapter::toQImage(std::move(img));
+            QMetaObject::invokeMethod(this, [this, job, preview] { showPreview(job, preview); },
+                                      Qt::QueuedConnection);
+        } catch (const iipt::OperationCancelled&) {
+            // Superseded by a newer change
+        } catch (const std::exception& e) {
+            QString message = QString::fromUtf8(e.what());
+            QMetaObject::invokeMethod(this, [this, job, message] { showPreviewError(job, message); },
+                                      Qt::QueuedConnection);
+        }
+    });
+}
+
+void MainWindow::showPreview(quint64 job, const QImage& preview)
+{
+    if (job != previewJob || !previewCheckBox->isChecked()) return;
+    previewShown = true;
+    ui->labelResultText->setText("Preview");
+    ui->labelResult->setPixmap(QPixmap::fromImage(preview).scaled(
+        ui->labelResult->size(),
+        Qt::KeepAspectRatio,
+        Qt::SmoothTransformation));
+}
+
+void MainWindow::showPreviewError(quint64 job, const QString& message)
+{
+    if (job != previewJob) return;
+    ui->statusbar->showMessage("Preview failed: " + message, 5000);
+}
+
+// Drops the pending and running preview; what is on screen stays
+void MainWindow::cancelPreview()
+{
+    previewTimer.stop();
+    if (previewToken) previewToken->cancel();
+    previewToken.reset();
+    ++previewJob;
 }
 
 // ------------------- Load & Save --------------------------
@@ -73,6 +460,7 @@ void MainWindow::on_actionLoad_Image_triggered()
         "Images (*.bmp)");
 
     if (!fileName.isEmpty()) {
+        cancelOperation();
         QImage image(fileName);
         if (image.isNull()) {
             QMessageBox::warning(this, "Load Image", "Could not load the selected image.");
@@ -82,7 +470,8 @@ void MainWindow::on_actionLoad_Image_triggered()
         settings.setValue("lastImageDir", QFileInfo(fileName).absolutePath());
 
         originalImage = image;
-        resultImage = image;
+        // Same pixels in the layout the operations produce, see `history`
+        resultImage = ImageQtAdapter::toQImage(ImageQtAdapter::fromQImage(image));
 
         ui->labelOriginal->setPixmap(QPixmap::fromImage(originalImage).scaled(
             ui->labelOriginal->size(), Qt::KeepAspectRatio, Qt::SmoothTransformation));
@@ -90,8 +479,7 @@ void MainWindow::on_actionLoad_Image_triggered()
         displayResult();
         updateImageInfo();
 
-        undoStack.clear();
-        redoStack.clear();
+        history.clear();
     }
 }
 
@@ -117,18 +505,20 @@ void MainWindow::on_actionSave_Image_triggered()
 
 void MainWindow::on_pushButtonUndo_clicked()
 {
-    if (!undoStack.isEmpty()) {
-        redoStack.push(resultImage);
-        resultImage = undoStack.pop();
+    cancelOperation();
+    iipt::Image previous;
+    if (history.undo(ImageQtAdapter::view(resultImage), previous)) {
+        resultImage = ImageQtAdapter::toQImage(std::move(previous));
         displayResult();
     }
 }
 
 void MainWindow::on_pushButtonRedo_clicked()
 {
-    if (!redoStack.isEmpty()) {
-        undoStack.push(resultImage);
-        resultImage = redoStack.pop();
+    cancelOperation();
+    iipt::Image next;
+    if (history.redo(ImageQtAdapter::view(resultImage), next)) {
+        resultImage = ImageQtAdapter::toQImage(std::move(next));
         displayResult();
     }
 }
@@ -154,49 +544,74 @@ void MainWindow::on_pbApplyNegative_clicked()
 {
     if (resultImage.isNull()) return;
 
-    pushToUndoStack();
-    iipt::Image img = ImageQtAdapter::fromQImage(resultImage);
-    iipt::ImageIntensityTransformation::applyNegative(img);
-    resultImage = ImageQtAdapter::toQImage(img);
-    displayResult();
+    runOperation([](iipt::Image& img) {
+        iipt::ImageIntensityTransformation::applyNegative(img);
+    });
+}
+
+MainWindow::Operation MainWindow::logOperation(double)
+{
+    bool ok;
+    float c = ui->lineLogScalingFactor->text().toFloat(&ok);
+    if (!ok) return {};
+
+    return [c](iipt::Image& img) {
+        iipt::ImageIntensityTransformation::applyLog(img, c);
+    };
 }
 
 void MainWindow::on_pbApplyLog_clicked()
 {
     if (resultImage.isNull()) return;
 
-    bool ok;
-    float c = ui->lineLogScalingFactor->text().toFloat(&ok);
-    if (!ok) {
+    Operation operation = logOperation(1.0);
+    if (!operation) {
         QMessageBox::warning(this, "Invalid Input", "Please enter a valid scaling factor.");
         return;
     }
-
-    pushToUndoStack();
-    iipt::Image img = ImageQtAdapter::fromQImage(resultImage);
-    iipt::ImageIntensityTransformation::applyLog(img, c);
-    resultImage = ImageQtAdapter::toQImage(img);
-    displayResult();
+    runOperation(operation);
 }
 
-void MainWindow::on_pbApplyGamma_clicked()
+MainWindow::Operation MainWindow::gammaOperation(double)
 {
-    if (resultImage.isNull()) return;
-
     bool ok1, ok2;
     float c = ui->lineGammaScalingFactor->text().toFloat(&ok1);
     float gamma = ui->lineGamma->text().toFloat(&ok2);
+    if (!ok1 || !ok2) return {};
+
+    return [gamma, c](iipt::Image& img) {
+        iipt::ImageIntensityTransformation::applyGamma(img, gamma, c);
+    };
+}
+
+void MainWindow::on_pbApplyGamma_clicked()
+{
+    if (resultImage.isNull()) return;
 
-    if (!ok1 || !ok2) {
+    Operation operation = gammaOperation(1.0);
+    if (!operation) {
         QMessageBox::warning(this, "Invalid Input", "Please enter valid values for scaling factor and gamma.");
         return;
     }
+    runOperation(operation);
+}
 
-    pushToUndoStack();
-    iipt::Image img = ImageQtAdapter::fromQImage(resultImage);
-    iipt::ImageIntensityTransformation::applyGamma(img, gamma, c);
-    resultImage = ImageQtAdapter::toQImage(img);
-    displayResult();
+// The tile grid is relative to the image, so the proxy needs no scaling
+MainWindow::Operation MainWindow::claheOperation(double)
+{
+    float clipLimit = ui->claheClipLimitSpinBox->value();
+    int tiles = ui->claheTilesSpinBox->value();
+
+    return [clipLimit, tiles](iipt::Image& img) {
+        iipt::ImageIntensityTransformation::applyCLAHE(img, clipLimit, tiles, tiles);
+    };
+}
+
+void MainWindow::on_pbApplyCLAHE_clicked()
+{
+    if (resultImage.isNull()) return;
+
+    runOperation(claheOperation(1.0));
 }
 
 //----------------- Stacked Pages --------------------------------
@@ -245,75 +660,81 @@ void MainWindow::onBlurKernelChanged(int index)
 
 
 
-void MainWindow::on_pushButtonLhFilter_clicked()
+MainWindow::Operation MainWindow::lowHighPassOperation(double scale)
 {
-    if (resultImage.isNull()) return;
-
-
-    pushToUndoStack();
-    iipt::Image img = ImageQtAdapter::fromQImage(resultImage);
-
     QString kernelType = ui->kernelTypeComboBox->currentText();
-    int kSize = ui->kernelSizeSpinBox->value();
-    float sigma = ui->sigmaDoubleSpinBox->value();
+    int kSize = previewKernelSize(ui->kernelSizeSpinBox->value(), scale);
+    float sigma = previewSigma(ui->sigmaDoubleSpinBox->value(), scale);
     QString paddingStr = ui->paddingTypeComboBox->currentText();
     iipt::SpatialTransformation::PaddingType padding = getPaddingFromString(paddingStr);
 
-    if (kernelType == "Box") {
-        iipt::SpatialTransformation::applyBoxFilter(img, kSize, padding);
-    } else if (kernelType == "Gaussian") {
-        iipt::SpatialTransformation::applyGaussianFilter(img, kSize, sigma, padding);
-    } else if (kernelType == "Median") {
-        iipt::SpatialTransformation::applyMedianFilter(img, kSize, padding);
-    }
-
-
-    resultImage = ImageQtAdapter::toQImage(img);
-    displayResult();
-    showDoneMessage();
+    return [kernelType, kSize, sigma, padding](iipt::Image& img) {
+        if (kernelType == "Box") {
+            iipt::SpatialTransformation::applyBoxFilter(img, kSize, padding);
+        } else if (kernelType == "Gaussian") {
+            iipt::SpatialTransformation::applyGaussianFilter(img, kSize, sigma, padding);
+        } else if (kernelType == "Median") {
+            iipt::SpatialTransformation::applyMedianFilter(img, kSize, padding);
+        } else if (kernelType == "Min") {
+            iipt::SpatialTransformation::applyMinFilter(img, kSize, padding);
+        } else if (kernelType == "Max") {
+            iipt::SpatialTransformation::applyMaxFilter(img, kSize, padding);
+        }
+    };
 }
 
-
-void MainWindow::on_pushButtonImageSharpening_clicked()
+void MainWindow::on_pushButtonLhFilter_clicked()
 {
     if (resultImage.isNull()) return;
 
-    pushToUndoStack();
-    iipt::Image img = ImageQtAdapter::fromQImage(resultImage);
+    runOperation(lowHighPassOperation(1.0));
+}
+
 
+// The Laplacian kernels are fixed 3x3, so the proxy shows them stronger than full size
+MainWindow::Operation MainWindow::sharpeningOperation(double)
+{
     QString method = ui->sharpeningMethodComboBox->currentText();
     QString paddingStr = ui->paddingTypeComboBox_2->currentText();
     iipt::SpatialTransformation::PaddingType padding = getPaddingFromString(paddingStr);
 
-    iipt::SpatialTransformation::applySharpening(img, method.toStdString(), padding);
-
-    resultImage = ImageQtAdapter::toQImage(img);
-    displayResult();
+    return [method = method.toStdString(), padding](iipt::Image& img) {
+        iipt::SpatialTransformation::applySharpening(img, method, padding);
+    };
 }
 
-
-void MainWindow::on_pushButtonUMHB_clicked()
+void MainWindow::on_pushButtonImageSharpening_clicked()
 {
     if (resultImage.isNull()) return;
 
-    pushToUndoStack();
-    iipt::Image img = ImageQtAdapter::fromQImage(resultImage);
+    runOperation(sharpeningOperation(1.0));
+}
+
 
-    QString kernelType = ui->blurKernelComboBox->currentText();
-    int kSize = ui->kernelSizeSpinBox_3->value();
-    float sigma = ui->sigmaDoubleSpinBox_2->value();
+MainWindow::Operation MainWindow::unsharpHighboostOperation(double scale)
+{
+    // The core takes the lowercase names ("box", "median", "gaussian") of the combo items
+    QString kernelType = ui->blurKernelComboBox->currentText().toLower();
+    int kSize = previewKernelSize(ui->kernelSizeSpinBox_3->value(), scale);
+    float sigma = previewSigma(ui->sigmaDoubleSpinBox_2->value(), scale);
     float gain = ui->gainDoubleSpinBox->value();
     QString paddingStr = ui->paddingTypeComboBox_3->currentText();
     iipt::SpatialTransformation::PaddingType padding = getPaddingFromString(paddingStr);
 
-    if (gain <= 1.0f) {
-        iipt::SpatialTransformation::applyUnsharpMasking(img, kernelType.toStdString(), kSize, sigma, padding);
-    } else {
-        iipt::SpatialTransformation::applyHighboostFiltering(img, kernelType.toStdString(), kSize, gain, sigma, padding);
-    }
+    return [kernel = kernelType.toStdString(), kSize, sigma, gain, padding](iipt::Image& img) {
+        if (gain <= 1.0f) {
+            iipt::SpatialTransformation::applyUnsharpMasking(img, kernel, kSize, sigma, padding);
+        } else {
+            iipt::SpatialTransformation::applyHighboostFiltering(img, kernel, kSize, gain, sigma, padding);
+        }
+    };
+}
 
-    resultImage = ImageQtAdapter::toQImage(img);
-    displayResult();
+void MainWindow::on_pushButtonUMHB_clicked()
+{
+    if (resultImage.isNull()) return;
+
+    runOperation(unsharpHighboostOperation(1.0));
 }
 
 iipt::SpatialTransformation::PaddingType MainWindow::getPaddingFromString(const QString& str) {
@@ -339,12 +760,9 @@ void MainWindow::on_actionRGB_to_Grayscale_triggered()
 {
     if (resultImage.isNull()) return;
 
-    pushToUndoStack();
-    iipt::Image img = ImageQtAdapter::fromQImage(resultImage);
-
-    iipt::RGBToGrayscaleConverter::convert(img);
-    resultImage = ImageQtAdapter::toQImage(img);
-    displayResult();
+    runOperation([](iipt::Image& img) {
+        iipt::RGBToGrayscaleConverter::convert(img);
+    });
 }
 
 
@@ -362,7 +780,11 @@ void MainWindow::on_actionGrayscale_to_Binary_triggered()
     ui->blockSizeSpinBox->setVisible(false);
     ui->cLabel->setVisible(false);
     ui->cSpinBox->setVisible(false);
+    ui->kLabel->setVisible(false);
+    ui->kDoubleSpinBox->setVisible(false);
 
+    // Resetting the fields is not a parameter change worth previewing
+    cancelPreview();
 }
 
 void MainWindow::on_methodGrayscaleToBinaryComboBox_currentIndexChanged(int index)
@@ -370,59 +792,67 @@ void MainWindow::on_methodGrayscaleToBinaryComboBox_currentIndexChanged(int inde
     // Show/hide relevant input fields
     bool isFixed = (index == 0);
     bool isAdaptive = (index == 2 || index == 3);
+    bool isLocalStats = (index == 4 || index == 5); // Niblack, Sauvola
 
     ui->thresholdValueLabel->setVisible(isFixed);
     ui->thresholdValueSpinBox->setVisible(isFixed);
 
-    ui->blockSizeLabel->setVisible(isAdaptive);
-    ui->blockSizeSpinBox->setVisible(isAdaptive);
+    ui->blockSizeLabel->setVisible(isAdaptive || isLocalStats);
+    ui->blockSizeSpinBox->setVisible(isAdaptive || isLocalStats);
 
     ui->cLabel->setVisible(isAdaptive);
     ui->cSpinBox->setVisible(isAdaptive);
+
+    ui->kLabel->setVisible(isLocalStats);
+    ui->kDoubleSpinBox->setVisible(isLocalStats);
+    if (index == 4) ui->kDoubleSpinBox->setValue(-0.2);
+    if (index == 5) ui->kDoubleSpinBox->setValue(0.5);
 }
 
 
 
-void MainWindow::on_pushButtonApplyGrayscaleToBinary_clicked()
+MainWindow::Operation MainWindow::grayscaleToBinaryOperation(double scale)
 {
-    if (resultImage.isNull()) return;
-
-    pushToUndoStack();
-    iipt::Image img = ImageQtAdapter::fromQImage(resultImage);
-
     int methodIndex = ui->methodGrayscaleToBinaryComboBox->currentIndex();
+    int threshold = ui->thresholdValueSpinBox->value();
+    int blockSize = previewKernelSize(ui->blockSizeSpinBox->value(), scale, 3);
+    int cValue = ui->cSpinBox->value();
+    float k = ui->kDoubleSpinBox->value();
+
+    return [methodIndex, threshold, blockSize, cValue, k](iipt::Image& img) {
+        switch (methodIndex) {
+        case 0: // Fixed
+            iipt::GrayscaleToBinaryConverter::fixedThreshold(img, threshold);
+            break;
+
+        case 1: // Otsu
+            iipt::GrayscaleToBinaryConverter::otsuThreshold(img);
+            break;
+
+        case 2: // Adaptive Mean
+            iipt::GrayscaleToBinaryConverter::adaptiveMeanThreshold(img, blockSize, cValue);
+            break;
+
+        case 3: // Adaptive Gaussian
+            iipt::GrayscaleToBinaryConverter::adaptiveGaussianThreshold(img, blockSize, cValue);
+            break;
+
+        case 4: // Niblack
+            iipt::GrayscaleToBinaryConverter::niblackThreshold(img, blockSize, k);
+            break;
+
+        case 5: // Sauvola
+            iipt::GrayscaleToBinaryConverter::sauvolaThreshold(img, blockSize, k);
+            break;
+        }
+    };
+}
 
-    switch (methodIndex) {
-    case 0: // Fixed
-        iipt::GrayscaleToBinaryConverter::fixedThreshold(
-            img,
-            ui->thresholdValueSpinBox->value()
-            );
-        break;
-
-    case 1: // Otsu
-        iipt::GrayscaleToBinaryConverter::otsuThreshold(img);
-        break;
-
-    case 2: // Adaptive Mean
-        iipt::GrayscaleToBinaryConverter::adaptiveMeanThreshold(
-            img,
-            ui->blockSizeSpinBox->value(),
-            ui->cSpinBox->value()
-            );
-        break;
-
-    case 3: // Adaptive Gaussian
-        iipt::GrayscaleToBinaryConverter::adaptiveGaussianThreshold(
-            img,
-            ui->blockSizeSpinBox->value(),
-            ui->cSpinBox->value()
-            );
-        break;
-    }
+void MainWindow::on_pushButtonApplyGrayscaleToBinary_clicked()
+{
+    if (resultImage.isNull()) return;
 
-    resultImage = ImageQtAdapter::toQImage(img);
-    displayResult();
+    runOperation(grayscaleToBinaryOperation(1.0));
 }
 
 
@@ -432,19 +862,19 @@ void MainWindow::on_actionBasic_Morphological_triggered()
 }
 
 
-void MainWindow::on_pushButtonApplyBasicMorphology_clicked()
+// Empty if the binary operators would get a color image
+MainWindow::Operation MainWindow::morphologyOperation(double scale)
 {
-    if (resultImage.isNull()) return;
+    // Channels of the iipt::Image the worker converts to (binary morphology needs 1)
+    int channels = resultImage.isGrayscale() ? 1 : 3;
 
-    // 1. convert to our Image class (must be 1‑channel for morphology)
-    iipt::Image img = ImageQtAdapter::fromQImage(resultImage);
-    if (img.channels != 1) {
-        QMessageBox::warning(this, "Morphology",
-                             "Please convert to grayscale/binary before applying morphology.");
-        return;
-    }
-
-    pushToUndoStack();
+    // Top-hat, black-hat and gradient only exist on gray levels, boundary extraction only
+    // on binary masks; the grayscale operations work per channel, the binary ones need one
+    bool grayscale = (ui->checkBoxGrayscaleMorphology->isChecked() && !ui->radioButtonBoundaryExtraction->isChecked()) ||
+                     ui->radioButtonTopHat->isChecked() ||
+                     ui->radioButtonBlackHat->isChecked() ||
+                     ui->radioButtonGradient->isChecked();
+    if (channels != 1 && !grayscale) return {};
 
     /* ------- SE shape & size ------- */
     QString shapeStr = "square";
@@ -454,7 +884,7 @@ void MainWindow::on_pushButtonApplyBasicMorphology_clicked()
     else if (ui->radioButtonHorizontalLine->isChecked())   shapeStr = "line_horizontal";
     else if (ui->radioButtonVerticalLine->isChecked())     shapeStr = "line_vertical";
 
-    int seSize = ui->spinBoxSeSize->value();               // odd numbers only
+    int seSize = previewKernelSize(ui->spinBoxSeSize->value(), scale, 3);   // odd numbers only
     auto se = iipt::ImageUtils::createStructuringElement(shapeStr.toStdString(), seSize);
 
 
@@ -468,18 +898,44 @@ void MainWindow::on_pushButtonApplyBasicMorphology_clicked()
 
     /*********** Basic Morphological Operation -------------------*/
 
-    if      (ui->radioButtonErosion->isChecked())               iipt::ImageMorphology::erosion(img, se, pad);
-    else if (ui->radioButtonDilation->isChecked())              iipt::ImageMorphology::dilation(img, se, pad);
-    else if (ui->radioButtonOpening->isChecked())               iipt::ImageMorphology::opening(img, se, pad);
-    else if (ui->radioButtonClosing->isChecked())               iipt::ImageMorphology::closing(img, se, pad);
-    else if (ui->radioButtonBoundaryExtraction->isChecked())    iipt::ImageMorphology::boundaryExtract(img, se, pad);
-
-
-   resultImage = ImageQtAdapter::toQImage(img);
-   displayResult();
-   showDoneMessage();
-
+    enum class Op { Erosion, Dilation, Opening, Closing, TopHat, BlackHat, Gradient, Boundary, None };
+    Op op = Op::None;
+    if      (ui->radioButtonErosion->isChecked())               op = Op::Erosion;
+    else if (ui->radioButtonDilation->isChecked())              op = Op::Dilation;
+    else if (ui->radioButtonOpening->isChecked())               op = Op::Opening;
+    else if (ui->radioButtonClosing->isChecked())               op = Op::Closing;
+    else if (ui->radioButtonTopHat->isChecked())                op = Op::TopHat;
+    else if (ui->radioButtonBlackHat->isChecked())              op = Op::BlackHat;
+    else if (ui->radioButtonGradient->isChecked())              op = Op::Gradient;
+    else if (ui->radioButtonBoundaryExtraction->isChecked())    op = Op::Boundary;
+
+    return [grayscale, op, se, pad](iipt::Image& img) {
+        if (grayscale) {
+            if      (op == Op::Erosion)     iipt::ImageMorphology::grayErosion(img, se, pad);
+            else if (op == Op::Dilation)    iipt::ImageMorphology::grayDilation(img, se, pad);
+            else if (op == Op::Opening)     iipt::ImageMorphology::grayOpening(img, se, pad);
+            else if (op == Op::Closing)     iipt::ImageMorphology::grayClosing(img, se, pad);
+            else if (op == Op::TopHat)      iipt::ImageMorphology::topHat(img, se, pad);
+            else if (op == Op::BlackHat)    iipt::ImageMorphology::blackHat(img, se, pad);
+            else if (op == Op::Gradient)    iipt::ImageMorphology::morphologicalGradient(img, se, pad);
+        }
+        else if (op == Op::Erosion)         iipt::ImageMorphology::erosion(img, se, pad);
+        else if (op == Op::Dilation)        iipt::ImageMorphology::dilation(img, se, pad);
+        else if (op == Op::Opening)         iipt::ImageMorphology::opening(img, se, pad);
+        else if (op == Op::Closing)         iipt::ImageMorphology::closing(img, se, pad);
+        else if (op == Op::Boundary)        iipt::ImageMorphology::boundaryExtract(img, se, pad);
+    };
+}
 
+void MainWindow::on_pushButtonApplyBasicMorphology_clicked()
+{
+    if (resultImage.isNull()) return;
 
+    Operation operation = morphologyOperation(1.0);
+    if (!operation) {
+        QMessageBox::warning(this, "Morphology",
+                             "Please convert to grayscale/binary before applying morphology.");
+        return;
+    }
+    runOperation(operation);
 }
-
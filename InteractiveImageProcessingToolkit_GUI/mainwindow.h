@@ -3,7 +3,16 @@
 
 #include <QMainWindow>
 #include <QImage>
-#include <QStack>
+#include <QCheckBox>
+#include <QElapsedTimer>
+#include <QLabel>
+#include <QProgressBar>
+#include <QPushButton>
+#include <QThreadPool>
+#include <QTimer>
+
+#include <functional>
+#include <memory>
 
 #include "ImageSpatialTransformation.h"
 #include "ImageIntensityTransformation.h"
@@ -11,6 +20,9 @@
 #include "ImageQtAdapter.h"
 #include "ImageMorphology.h"
 #include "ImageUtils.h"
+#include "ImageHistory.h"
+#include "Profiler.h"
+#include "Progress.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui {
@@ -43,6 +55,8 @@ private slots:
 
     void on_pbApplyGamma_clicked();
 
+    void on_pbApplyCLAHE_clicked();
+
     void on_actionSpatial_Transformations_triggered();
 
     void onLowHighPassKernelChanged(int index);
@@ -68,23 +82,85 @@ private slots:
 
     void on_pushButtonApplyBasicMorphology_clicked();
 
+    void cancelOperation();
+
 private:
     Ui::MainWindow *ui;
     QImage originalImage;
     QImage resultImage;
-    QStack<QImage> undoStack;
-    QStack<QImage> redoStack;
+    // Undo / redo as deltas against resultImage, within the "undoMemoryMB" setting
+    // (512 MB by default). resultImage is always Grayscale8 or RGB888, so its pixels can
+    // be read in place through ImageQtAdapter::view.
+    iipt::ImageHistory history;
     iipt::SpatialTransformation::PaddingType getPaddingFromString(const QString& str);
 
 
-    void pushToUndoStack();
+    void pushToUndoStack(iipt::ImageHistory::Delta delta);
     void displayResult();
     void updateImageInfo();
 
     void showDoneMessage(int timeoutMs = 2000);
-
-
-
+    void showOperationTime();
+    void stopProfiling();
+
+    using Operation = std::function<void(iipt::Image&)>;
+    // Operation of one panel built from its widgets. scale is the size of the image it
+    // will run on relative to resultImage; spatial parameters (kernel, sigma, block and
+    // SE size) shrink with it so a preview proxy looks like the full-size result.
+    using OperationBuilder = Operation (MainWindow::*)(double scale);
+    Operation logOperation(double scale);
+    Operation gammaOperation(double scale);
+    Operation claheOperation(double scale);
+    Operation lowHighPassOperation(double scale);
+    Operation sharpeningOperation(double scale);
+    Operation unsharpHighboostOperation(double scale);
+    Operation grayscaleToBinaryOperation(double scale);
+    Operation morphologyOperation(double scale);
+
+    // Operations run on a copy of resultImage in operationPool, so the window stays
+    // responsive. Each request gets a new job number and cancels the job before it; a
+    // finished job is applied (with an undo entry) only if it is still currentJob.
+    void runOperation(Operation operation);
+    void updateProgress(quint64 job, int pass, int percent);
+    void finishOperation(quint64 job, const QImage& result, std::shared_ptr<iipt::ImageHistory::Delta> delta,
+                         int thread);
+    void failOperation(quint64 job, const QString& message);
+    void stopProgress();
+
+    QThreadPool operationPool;
+    std::shared_ptr<iipt::ProgressToken> runningToken;
+    quint64 currentJob = 0;
+    int progressPass = 0;
+    QProgressBar *progressBar = nullptr;
+    QPushButton *cancelButton = nullptr;
+
+    // Live preview: a parameter change runs the operation of its panel on proxyImage, a
+    // copy of resultImage downscaled to labelResult, and shows the outcome there without
+    // touching resultImage. Changes are debounced by previewTimer and each preview
+    // cancels the one before it; only the apply buttons run at full resolution.
+    void connectPreview();
+    void schedulePreview(OperationBuilder builder);
+    void runPreview();
+    void showPreview(quint64 job, const QImage& preview);
+    void showPreviewError(quint64 job, const QString& message);
+    void cancelPreview();
+
+    QThreadPool previewPool;
+    QTimer previewTimer;
+    QCheckBox *previewCheckBox = nullptr;
+    OperationBuilder previewBuilder = nullptr;
+    std::shared_ptr<iipt::ProgressToken> previewToken;
+    quint64 previewJob = 0;
+    bool previewShown = false;
+    std::shared_ptr<const iipt::Image> proxyImage;      // built for proxyKey / proxyBounds
+    qint64 proxyKey = 0;
+    QSize proxyBounds;
+
+    // Per-operation timing in the status bar: started by runOperation() and reported by
+    // displayResult()
+    QLabel *timingLabel = nullptr;
+    QElapsedTimer operationTimer;
+    int profileThread = -1;     // Profiler thread of the finished job
 
 };
 #endif // MAINWINDOW_H